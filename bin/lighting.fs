@@ -1,10 +1,10 @@
-#version 330 core
+#version 430 core
 out vec4 FragColor;
 
 struct Material {
-    sampler2D diffuse;
-    sampler2D specular;
-    float shininess;
+    // Layers of the block texture array, picked by TexLayer
+    sampler2DArray diffuse;
+    sampler2DArray specular;
 }; 
 
 struct DirLight {
@@ -27,40 +27,46 @@ struct PointLight {
     vec3 specular;
 };
 
-struct SpotLight {
-    vec3 position;
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
-  
-    float constant;
-    float linear;
-    float quadratic;
-  
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;       
-};
-
-#define NR_POINT_LIGHTS 4
-
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
+flat in int TexLayer;
 
-uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform PointLight pointLights[100];
-uniform SpotLight spotLight;
 uniform Material material;
-uniform int pointLightCount;
-uniform bool blinn;
-uniform bool gamma;
+
+// Everything that changes once a frame, packed by packFrameData in frameUniforms.h. The same in every shader that uses it.
+layout(std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    float shininess;
+    vec3 sunDirection;
+    int pointLightCount;
+    vec3 sunAmbient;
+    bool blinn;
+    vec3 sunDiffuse;
+    bool gamma;
+    vec3 sunSpecular;
+    float clusterZScale;
+    vec2 clusterTileScale;
+    float clusterZBias;
+};
+
+// Every slot of the LightRegistry in lightRegistry.h, it grows as lights are added so the array has no fixed size.
+// Only the lights in a fragment's cluster are read, slots of removed lights never are.
+layout(std430, binding = 1) buffer LightData {
+    PointLight pointLights[];
+};
+
+// The view frustum split into clusters, CLUSTER_COUNT_X, _Y and _Z are defined from lightClusters.h when this is compiled
+// Where each cluster's lights start in clusterLightIndices and how many there are
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterLightIndices;
 
 // function prototypes
+int ClusterIndex();
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 
 
 void main()
@@ -68,19 +74,26 @@ void main()
     // properties
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(viewPos - FragPos);
+    DirLight dirLight = DirLight(sunDirection, sunAmbient, sunDiffuse, sunSpecular);
     
     // == =====================================================
-    // Our lighting is set up in 3 phases: directional, point lights and an optional flashlight
+    // Our lighting is set up in 2 phases: directional and point lights
     // For each phase, a calculate function is defined that calculates the corresponding color
     // per lamp. In the main() function we take all the calculated colors and sum them up for
     // this fragment's final color.
     // == =====================================================
     // phase 1: directional lighting
     vec3 result = CalcDirLight(dirLight, norm, viewDir);
-    // phase 2: point lights
-    for(int i = 0; i < pointLightCount; i++)
-        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);    
-    // phase 3: spot light
+    // phase 2: point lights, only the ones that reach this fragment's cluster. With none placed the cluster isn't looked up
+    if (pointLightCount > 0)
+    {
+        uvec2 cluster = texelFetch(clusterGrid, ClusterIndex()).xy;
+        for(uint i = 0u; i < cluster.y; i++)
+        {
+            int light = int(texelFetch(clusterLightIndices, int(cluster.x + i)).x);
+            result += CalcPointLight(pointLights[light], norm, FragPos, viewDir);
+        }
+    }
     if (gamma)
     {
         float gammaValue = 2.2; // Typical gamma value
@@ -89,6 +102,15 @@ void main()
     FragColor = vec4(result, 1.0);
 }
 
+// finds the cluster this fragment is in from where it is on screen and how far it is from the camera
+int ClusterIndex()
+{
+    float depth = max(-(view * vec4(FragPos, 1.0)).z, 0.0001);
+    int slice = clamp(int(floor(log(depth) * clusterZScale - clusterZBias)), 0, CLUSTER_COUNT_Z - 1);
+    ivec2 tile = clamp(ivec2(gl_FragCoord.xy * clusterTileScale), ivec2(0), ivec2(CLUSTER_COUNT_X - 1, CLUSTER_COUNT_Y - 1));
+    return tile.x + CLUSTER_COUNT_X * (tile.y + CLUSTER_COUNT_Y * slice);
+}
+
 // calculates the color when using a directional light.
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
 {
@@ -100,17 +122,17 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     if (blinn)
     {
         vec3 halfwayDir = normalize(lightDir + viewDir);
-        spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+        spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
     }
     else
     {
         vec3 reflectDir = reflect(-lightDir, normal);
-        spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+        spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
     }
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient = light.ambient * vec3(texture(material.diffuse, vec3(TexCoords, TexLayer)));
+    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, vec3(TexCoords, TexLayer)));
+    vec3 specular = light.specular * spec * vec3(texture(material.specular, vec3(TexCoords, TexLayer)));
     return (ambient + diffuse + specular);
 }
 
@@ -125,57 +147,22 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     if (blinn)
     {
         vec3 halfwayDir = normalize(lightDir + viewDir);
-        spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+        spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
     }
     else
     {
         vec3 reflectDir = reflect(-lightDir, normal);
-        spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+        spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
     }
     // attenuation
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient = light.ambient * vec3(texture(material.diffuse, vec3(TexCoords, TexLayer)));
+    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, vec3(TexCoords, TexLayer)));
+    vec3 specular = light.specular * spec * vec3(texture(material.specular, vec3(TexCoords, TexLayer)));
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
     return (ambient + diffuse + specular);
-}
-
-// calculates the color when using a spot light.
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
-{
-    vec3 lightDir = normalize(light.position - fragPos);
-    // diffuse shading
-    float diff = max(dot(normal, lightDir), 0.0);
-    // specular shading
-    float spec;
-    if (blinn)
-    {
-        vec3 halfwayDir = normalize(lightDir + viewDir);
-        spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
-    }
-    else
-    {
-        vec3 reflectDir = reflect(-lightDir, normal);
-        spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    }
-    // attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
-    // spotlight intensity
-    float theta = dot(lightDir, normalize(-light.direction)); 
-    float epsilon = light.cutOff - light.outerCutOff;
-    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
-    // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
-    ambient *= attenuation * intensity;
-    diffuse *= attenuation * intensity;
-    specular *= attenuation * intensity;
-    return (ambient + diffuse + specular);
 }
\ No newline at end of file
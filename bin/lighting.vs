@@ -1,16 +1,34 @@
-#version 330 core
+#version 430 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 layout (location = 3) in vec3 aInstancePos;
+layout (location = 4) in uint aInstanceLayer;
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+flat out int TexLayer;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// Everything that changes once a frame, packed by packFrameData in frameUniforms.h. The same in every shader that uses it.
+layout(std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    float shininess;
+    vec3 sunDirection;
+    int pointLightCount;
+    vec3 sunAmbient;
+    bool blinn;
+    vec3 sunDiffuse;
+    bool gamma;
+    vec3 sunSpecular;
+    float clusterZScale;
+    vec2 clusterTileScale;
+    float clusterZBias;
+};
 
 void main()
 {
@@ -20,6 +38,7 @@ void main()
     FragPos = worldPosition;
     Normal = mat3(transpose(inverse(model))) * aNormal;  
     TexCoords = aTexCoords;
+    TexLayer = int(aInstanceLayer);
 
     // Apply the view and projection transformations
     gl_Position = projection * view * vec4(worldPosition, 1.0);
@@ -0,0 +1,51 @@
+#version 430 core
+// Chunk mesh vertices are packed into two unsigned ints, see PackedVertex in mesher.h
+layout (location = 0) in uvec2 aPacked;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+flat out int TexLayer;
+
+uniform vec3 chunkOrigin;
+
+// Everything that changes once a frame, packed by packFrameData in frameUniforms.h. The same in every shader that uses it.
+layout(std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    float shininess;
+    vec3 sunDirection;
+    int pointLightCount;
+    vec3 sunAmbient;
+    bool blinn;
+    vec3 sunDiffuse;
+    bool gamma;
+    vec3 sunSpecular;
+    float clusterZScale;
+    vec2 clusterTileScale;
+    float clusterZBias;
+};
+
+const vec3 normals[6] = vec3[6](
+    vec3(-1.0, 0.0, 0.0), vec3(1.0, 0.0, 0.0),
+    vec3(0.0, -1.0, 0.0), vec3(0.0, 1.0, 0.0),
+    vec3(0.0, 0.0, -1.0), vec3(0.0, 0.0, 1.0)
+);
+
+void main()
+{
+    uint position = aPacked.x;
+    uint material = aPacked.y;
+    vec3 localPos = vec3(float(position & 31u), float((position >> 5) & 127u), float((position >> 12) & 31u));
+
+    // Blocks are centred on whole numbers, so their corners are half a block either side
+    vec3 worldPosition = chunkOrigin + localPos - vec3(0.5);
+
+    FragPos = worldPosition;
+    Normal = normals[(position >> 17) & 7u];
+    TexCoords = vec2(float(material & 255u), float((material >> 8) & 255u));
+    TexLayer = int(material >> 16);
+
+    gl_Position = projection * view * vec4(worldPosition, 1.0);
+}
@@ -5,16 +5,158 @@
 #include <glm/glm.hpp>
 
 #include <string>
+#include <string_view>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// A uniform's location together with the type it takes, looked up once so setting it every frame is just the glUniform call
+template <typename T>
+struct Uniform
+{
+    int location = -1;
+
+    // False if the program has no such uniform (or the compiler removed it), setting it then does nothing
+    bool valid() const { return location != -1; }
+};
+
+// What a UniformTable needs to know about a linked program, GLUniformReflection asks OpenGL but it can be faked without a context
+class UniformReflection
+{
+public:
+    virtual ~UniformReflection() {}
+    virtual int activeUniformCount() const = 0;
+    // Name and array size of an active uniform, an array of plain values is listed once under its first element ("values[0]")
+    virtual void activeUniform(int index, std::string& name, int& size) const = 0;
+    virtual int uniformLocation(const char* name) const = 0;
+};
+
+class GLUniformReflection : public UniformReflection
+{
+public:
+    GLUniformReflection(unsigned int program) : program(program) {
+        GLint maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        buffer.resize(maxLength > 0 ? maxLength : 1);
+    }
+
+    int activeUniformCount() const override {
+        GLint count = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        return count;
+    }
+
+    void activeUniform(int index, std::string& name, int& size) const override {
+        GLsizei length = 0;
+        GLint arraySize = 0;
+        GLenum type;
+        glGetActiveUniform(program, index, (GLsizei)buffer.size(), &length, &arraySize, &type, buffer.data());
+        name.assign(buffer.data(), length);
+        size = arraySize;
+    }
+
+    int uniformLocation(const char* name) const override {
+        return glGetUniformLocation(program, name);
+    }
+
+private:
+    unsigned int program;
+    mutable std::vector<char> buffer;
+};
+
+/*
+Every uniform location of a program, read once after linking and hashed by name. Looking a name up never allocates or
+calls into the driver, and names that aren't in the program give -1 just like glGetUniformLocation. Arrays of plain values
+get an entry for every element as well as their bare name, struct arrays are already listed by the driver one member at a
+time ("pointLights[3].position"). Uniforms inside uniform blocks have no location and are left out.
+*/
+class UniformTable
+{
+public:
+    UniformTable() {}
+    UniformTable(const UniformTable&) = delete;
+    UniformTable& operator=(const UniformTable&) = delete;
+
+    void build(const UniformReflection& program) {
+        names.clear();
+        locations.clear();
+        table.clear();
+        int count = program.activeUniformCount();
+        std::string name;
+        int size;
+        for (int i = 0; i < count; i++) {
+            program.activeUniform(i, name, size);
+            bool isArray = name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0;
+            if (!isArray) {
+                add(name, program.uniformLocation(name.c_str()));
+                continue;
+            }
+            std::string base = name.substr(0, name.size() - 3);
+            add(base, program.uniformLocation(name.c_str()));
+            for (int element = 0; element < size; element++) {
+                std::string elementName = base + "[" + std::to_string(element) + "]";
+                add(elementName, program.uniformLocation(elementName.c_str()));
+            }
+        }
+        // The keys point into names, so they're only made once names has stopped growing
+        table.reserve(names.size());
+        for (size_t i = 0; i < names.size(); i++) {
+            table.emplace(std::string_view(names[i]), locations[i]);
+        }
+    }
+
+    int location(std::string_view name) const {
+        auto found = table.find(name);
+        return found == table.end() ? -1 : found->second;
+    }
+
+    size_t size() const {
+        return table.size();
+    }
+
+private:
+    std::vector<std::string> names;
+    std::vector<int> locations;
+    std::unordered_map<std::string_view, int> table;
+
+    void add(const std::string& name, int location) {
+        if (location < 0) {
+            return;
+        }
+        names.push_back(name);
+        locations.push_back(location);
+    }
+};
+
+/*
+Puts defines into shader source straight after its #version line, which has to stay first. This is how numbers the C++
+side decides are given to a shader, so the two can't end up different.
+*/
+inline std::string insertDefines(const std::string& source, const std::string& defines) {
+    if (defines.empty()) {
+        return source;
+    }
+    size_t start = source.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos || source.compare(start, 8, "#version") != 0) {
+        return defines + source;
+    }
+    size_t lineEnd = source.find('\n', start);
+    if (lineEnd == std::string::npos) {
+        return source + "\n" + defines;
+    }
+    return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+}
 
 class Shader
 {
 public:
     unsigned int ID;
 
-    void createShader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr) {
+    // defines are lines of #define put in every stage after its #version line, see insertDefines
+    void createShader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const std::string& defines = "") {
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
@@ -39,8 +181,8 @@ public:
             vShaderFile.close();
             fShaderFile.close();
             // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
+            vertexCode = insertDefines(vShaderStream.str(), defines);
+            fragmentCode = insertDefines(fShaderStream.str(), defines);
             // if geometry shader path is present, also load a geometry shader
             if(geometryPath != nullptr)
             {
@@ -48,7 +190,7 @@ public:
                 std::stringstream gShaderStream;
                 gShaderStream << gShaderFile.rdbuf();
                 gShaderFile.close();
-                geometryCode = gShaderStream.str();
+                geometryCode = insertDefines(gShaderStream.str(), defines);
             }
         }
         catch (std::ifstream::failure& e)
@@ -92,6 +234,40 @@ public:
         glDeleteShader(fragment);
         if(geometryPath != nullptr)
             glDeleteShader(geometry);
+        cacheUniforms();
+    }
+    // read every uniform location once, so none of the setters have to ask the driver
+    // ------------------------------------------------------------------------
+    void cacheUniforms()
+    {
+        cacheUniforms(GLUniformReflection(ID));
+    }
+    // the same from any reflection, so the lookups can be checked without a GL context
+    void cacheUniforms(const UniformReflection& program)
+    {
+        uniforms = std::make_shared<UniformTable>();
+        uniforms->build(program);
+    }
+    int uniformLocation(std::string_view name) const
+    {
+        return uniforms ? uniforms->location(name) : -1;
+    }
+    // point one of the program's uniform blocks at a binding point, does nothing if the program doesn't have it
+    // ------------------------------------------------------------------------
+    void bindUniformBlock(const char* name, unsigned int binding) const
+    {
+        unsigned int index = glGetUniformBlockIndex(ID, name);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
+    // typed handles for uniforms that are set every frame, look them up once and pass them to set()
+    // ------------------------------------------------------------------------
+    template <typename T>
+    Uniform<T> uniform(std::string_view name) const
+    {
+        Uniform<T> handle;
+        handle.location = uniformLocation(name);
+        return handle;
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -101,64 +277,105 @@ public:
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    void setBool(std::string_view name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(uniformLocation(name), (int)value); 
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setInt(std::string_view name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(uniformLocation(name), value); 
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(std::string_view name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(uniformLocation(name), value); 
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
+    void setVec2(std::string_view name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(uniformLocation(name), 1, &value[0]); 
     }
-    void setVec2(const std::string &name, float x, float y) const
+    void setVec2(std::string_view name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(uniformLocation(name), x, y); 
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
+    void setVec3(std::string_view name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(uniformLocation(name), 1, &value[0]); 
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
+    void setVec3(std::string_view name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(uniformLocation(name), x, y, z); 
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
+    void setVec4(std::string_view name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(uniformLocation(name), 1, &value[0]); 
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) 
+    void setVec4(std::string_view name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(uniformLocation(name), x, y, z, w); 
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(std::string_view name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat3(std::string_view name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void setMat4(std::string_view name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
+    }
+
+    // ------------------------------------------------------------------------
+    void set(Uniform<bool> uniform, bool value) const
+    {
+        glUniform1i(uniform.location, (int)value);
+    }
+    void set(Uniform<int> uniform, int value) const
+    {
+        glUniform1i(uniform.location, value);
+    }
+    void set(Uniform<float> uniform, float value) const
+    {
+        glUniform1f(uniform.location, value);
+    }
+    void set(Uniform<glm::vec2> uniform, const glm::vec2 &value) const
+    {
+        glUniform2fv(uniform.location, 1, &value[0]);
+    }
+    void set(Uniform<glm::vec3> uniform, const glm::vec3 &value) const
+    {
+        glUniform3fv(uniform.location, 1, &value[0]);
+    }
+    void set(Uniform<glm::vec4> uniform, const glm::vec4 &value) const
+    {
+        glUniform4fv(uniform.location, 1, &value[0]);
+    }
+    void set(Uniform<glm::mat2> uniform, const glm::mat2 &mat) const
+    {
+        glUniformMatrix2fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void set(Uniform<glm::mat3> uniform, const glm::mat3 &mat) const
+    {
+        glUniformMatrix3fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void set(Uniform<glm::mat4> uniform, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    // shared so copies of a Shader use the same table, the table's keys point into its own strings
+    std::shared_ptr<UniformTable> uniforms;
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -4,6 +4,7 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
 #include "cube.h"
 
 // Defines several possible options for camera movement. Used as abstraction to stay away from window-system specific input methods
@@ -22,6 +23,12 @@ const float SPEED       =  4.3f;
 const float SENSITIVITY =  0.1f;
 const float ZOOM        =  75.0f;
 
+// Physics always moves in steps of this length however fast frames are drawn, so it plays out the same on every machine
+const float PHYSICS_STEP      = 1.0f / 60.0f;
+// After a long stall only this many steps are run at once, otherwise catching up could make the next frame even longer
+const int   MAX_PHYSICS_STEPS = 8;
+const float GRAVITY           = -15.8f;
+
 class Camera
 {
 public:
@@ -40,7 +47,10 @@ public:
     float maxFov;
     float minFov;
     float size = 0.6f;
-    glm::vec3 velocity;
+    glm::vec3 velocity = glm::vec3(0.0f);
+    // Where the camera is drawn from, between the last two physics steps so movement looks smooth at any frame rate
+    glm::vec3 renderPosition;
+    glm::vec3 previousPosition;
     bool inAir = false;
     bool isJumping = false;
 
@@ -51,6 +61,7 @@ public:
         WorldUp = up;
         Yaw = yaw;
         Pitch = pitch;
+        renderPosition = previousPosition = Position;
         updateCameraVectors();
     }
     Camera(float posX, float posY, float posZ, float upX, float upY, float upZ, float yaw, float pitch) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM), minFov(1.0f), maxFov(90.0f)
@@ -59,6 +70,7 @@ public:
         WorldUp = glm::vec3(upX, upY, upZ);
         Yaw = yaw;
         Pitch = pitch;
+        renderPosition = previousPosition = Position;
         updateCameraVectors();
     }
     glm::vec3 getMinBounds() {
@@ -77,79 +89,46 @@ public:
         }
     }
 
-    cube* checkCameraCollision(std::vector<cube*> listOfCubes) {
-    for (cube* c : listOfCubes) {
-        glm::vec3 minA = getMinBounds();
-        glm::vec3 maxA = getMaxBounds();
-        glm::vec3 minB = c->getMinBounds();
-        glm::vec3 maxB = c->getMaxBounds();
-
-        if (!(maxA.x < minB.x || minA.x > maxB.x || 
-              maxA.y < minB.y || minA.y > maxB.y || 
-              maxA.z < minB.z || minA.z > maxB.z)) {
-            // Collision detected
-            inAir = false;
-            return c;
-        }
-        inAir = true;
-
-    }
-    return nullptr;  // No collision
-    }
-
     glm::mat4 GetViewMatrix() {
-        return glm::lookAt(Position, Position + Front, Up);
+        return glm::lookAt(renderPosition, renderPosition + Front, Up);
     }
 
-    void updateCameraPosition(float deltaTime) {
-    // Apply gravity
-    velocity.y += -15.8f * deltaTime;
-    Position += velocity * deltaTime;
-
-    // Check for collisions with cubes
-    cube* collidedCube = checkCameraCollision(cubes);
-    if (collidedCube) {
-        glm::vec3 cubeMaxBounds = collidedCube->getMaxBounds();
-
-        // Place the camera on top of the cube and reset jump state
-        if (Position.y < cubeMaxBounds.y + size + 0.7f) {
-            Position.y = cubeMaxBounds.y + size + 0.7f;
-            velocity.y = 0.0f; // Stop downward motion
-            isJumping = false; // Allow jumping again
+    /*
+    Runs as many fixed physics steps as fit in the time since the last frame, the time left over carries on to the next frame.
+    renderPosition is then blended between the last two steps by how far into the next step the frame is.
+    */
+    void updatePhysics(const VoxelWorld& world, float frameTime) {
+        physicsTime += frameTime;
+        if (physicsTime > MAX_PHYSICS_STEPS * PHYSICS_STEP) {
+            physicsTime = MAX_PHYSICS_STEPS * PHYSICS_STEP;
         }
-    } else if (Position.y <= 0.0f) {
-        // Prevent the camera from falling below ground level
-        Position.y = 0.0f;
-        velocity.y = 0.0f;
-        isJumping = false; // Allow jumping again
-    }
+        while (physicsTime >= PHYSICS_STEP) {
+            previousPosition = Position;
+            stepPhysics(world, PHYSICS_STEP);
+            physicsTime -= PHYSICS_STEP;
+        }
+        renderPosition = glm::mix(previousPosition, Position, physicsTime / PHYSICS_STEP);
+        // The keys are read again every frame, so what was held this frame is forgotten once it has been used
+        moveDirection = glm::vec3(0.0f);
     }
 
-    void ProcessKeyboard(Camera_Movement direction, float deltaTime) {
-        float velocity = MovementSpeed * deltaTime;
-
+    void ProcessKeyboard(Camera_Movement direction) {
         // Create a modified Front vector with the y component set to 0
         glm::vec3 flatFront = glm::normalize(glm::vec3(Front.x, 0.0f, Front.z));
 
         if(direction == FORWARD) {
-            Position += flatFront * velocity;
+            moveDirection += flatFront;
         }
         if(direction == BACKWARD) {
-            Position -= flatFront * velocity;
+            moveDirection -= flatFront;
         }
         if(direction == LEFT) {
-            Position -= Right * velocity;
+            moveDirection -= Right;
         }
         if(direction == RIGHT) {
-            Position += Right * velocity;
+            moveDirection += Right;
         }
-        
-
-        // Optional: Keep Position.y at a fixed value if needed
-        
     }
-
-
     void ProcessMouseMovement(float xoffset, float yoffset, GLboolean contrainPitch = true) {
         xoffset *= MouseSensitivity;
         yoffset *= MouseSensitivity;
@@ -173,6 +152,121 @@ public:
             Zoom = maxFov;
     }
 private:
+    // Which way the movement keys are pushing this frame, set by ProcessKeyboard and used by every physics step
+    glm::vec3 moveDirection = glm::vec3(0.0f);
+    float physicsTime = 0.0f;
+
+    // One fixed step: gravity and the movement keys set the velocity and then the camera is moved one axis at a time
+    void stepPhysics(const VoxelWorld& world, float step) {
+        velocity.y += GRAVITY * step;
+        velocity.x = moveDirection.x * MovementSpeed;
+        velocity.z = moveDirection.z * MovementSpeed;
+
+        // Anything that ends up inside the ground (spawning, a new world being swapped in) is lifted out a block at a time
+        if (isInsideBlock(world)) {
+            Position.y += 1.0f;
+            velocity.y = 0.0f;
+            return;
+        }
+
+        inAir = true;
+        // Up and down first so the camera lands before sliding sideways, that way it doesn't catch on the ground's edges
+        moveAxis(world, 1, velocity.y * step);
+        moveAxis(world, 0, velocity.x * step);
+        moveAxis(world, 2, velocity.z * step);
+
+        // Prevent the camera from falling below ground level
+        if (Position.y <= 0.0f) {
+            Position.y = 0.0f;
+            velocity.y = 0.0f;
+            inAir = false;
+            isJumping = false;
+        }
+    }
+
+    // True if the camera's box is properly inside a block, just touching one doesn't count
+    bool isInsideBlock(const VoxelWorld& world) {
+        const float skin = 0.0001f;
+        glm::ivec3 minCell = glm::ivec3(glm::floor(getMinBounds() + glm::vec3(skin - 0.5f))) + glm::ivec3(1);
+        glm::ivec3 maxCell = glm::ivec3(glm::ceil(getMaxBounds() - glm::vec3(skin - 0.5f))) - glm::ivec3(1);
+        for (int y = minCell.y; y <= maxCell.y; y++) {
+            for (int z = minCell.z; z <= maxCell.z; z++) {
+                for (int x = minCell.x; x <= maxCell.x; x++) {
+                    if (world.isSolid(x, y, z)) {
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    /*
+    Moves the camera's box distance along one axis, stopping it against the first block in the way. Every cell the box would
+    pass through is checked rather than just where it ends up, so the camera can't pass through a block however far it moves
+    in one step. Blocks are centred on whole numbers, and the box is shrunk by a tiny amount across the other two axes so
+    resting on the ground or brushing a wall doesn't count as being in the way.
+    */
+    void moveAxis(const VoxelWorld& world, int axis, float distance) {
+        if (distance == 0.0f) {
+            return;
+        }
+        const float skin = 0.0001f;
+        glm::vec3 minA = getMinBounds();
+        glm::vec3 maxA = getMaxBounds();
+        int axis0 = (axis + 1) % 3;
+        int axis1 = (axis + 2) % 3;
+        int start0 = (int)floor(minA[axis0] + skin - 0.5f) + 1;
+        int end0 = (int)ceil(maxA[axis0] - skin + 0.5f) - 1;
+        int start1 = (int)floor(minA[axis1] + skin - 0.5f) + 1;
+        int end1 = (int)ceil(maxA[axis1] - skin + 0.5f) - 1;
+
+        auto layerIsSolid = [&](int layer) {
+            for (int a = start0; a <= end0; a++) {
+                for (int b = start1; b <= end1; b++) {
+                    int cell[3];
+                    cell[axis] = layer;
+                    cell[axis0] = a;
+                    cell[axis1] = b;
+                    if (world.isSolid(cell[0], cell[1], cell[2])) {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        };
+
+        if (distance > 0.0f) {
+            // Layers whose near side lies between the box's leading side and where it would end up
+            int first = (int)ceil(maxA[axis] + 0.5f - skin);
+            int last = (int)ceil(maxA[axis] + distance + 0.5f) - 1;
+            for (int layer = first; layer <= last; layer++) {
+                if (layerIsSolid(layer)) {
+                    distance = std::max(0.0f, (layer - 0.5f) - maxA[axis]);
+                    velocity[axis] = 0.0f;
+                    break;
+                }
+            }
+        }
+        else {
+            int first = (int)floor(minA[axis] - 0.5f + skin);
+            int last = (int)floor(minA[axis] + distance - 0.5f) + 1;
+            for (int layer = first; layer >= last; layer--) {
+                if (layerIsSolid(layer)) {
+                    distance = std::min(0.0f, (layer + 0.5f) - minA[axis]);
+                    velocity[axis] = 0.0f;
+                    if (axis == 1) {
+                        // Landed on something
+                        inAir = false;
+                        isJumping = false;
+                    }
+                    break;
+                }
+            }
+        }
+        Position[axis] += distance;
+    }
+
     void updateCameraVectors() {
         // calculate the new Front vector
         glm::vec3 front;
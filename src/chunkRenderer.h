@@ -0,0 +1,147 @@
+#ifndef CHUNKRENDERER_H
+#define CHUNKRENDERER_H
+
+#include <glad/glad.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "shader.h"
+#include "cube.h"
+#include "world.h"
+#include "mesher.h"
+
+// The vertex buffer holding one chunk's mesh
+struct ChunkMesh
+{
+    unsigned int VAO;
+    unsigned int VBO;
+    int vertexCount;
+    MeshMode mode;   // How the mesh was made, so meshes from before the mode changed can be found
+};
+
+typedef std::unordered_map<ChunkCoord, ChunkMesh, ChunkCoordHash> ChunkMeshMap;
+
+// The meshes that get drawn, a world being built in the background keeps its meshes in its own map until it is swapped in
+ChunkMeshMap chunkMeshes;
+// Greedy meshing merges flat runs of the same block into big quads, the N key switches back to one quad per face
+MeshMode chunkMeshMode = MESH_GREEDY;
+
+void destroyChunkMesh(ChunkMesh& mesh) {
+    glDeleteVertexArrays(1, &mesh.VAO);
+    glDeleteBuffers(1, &mesh.VBO);
+}
+
+void deleteChunkMesh(ChunkCoord coord, ChunkMeshMap& meshes = chunkMeshes) {
+    auto it = meshes.find(coord);
+    if (it == meshes.end()) {
+        return;
+    }
+    destroyChunkMesh(it->second);
+    meshes.erase(it);
+}
+
+void clearChunkMeshes(ChunkMeshMap& meshes = chunkMeshes) {
+    for (auto& entry : meshes) {
+        destroyChunkMesh(entry.second);
+    }
+    meshes.clear();
+}
+
+// Puts a chunk's vertices in its own buffer, replacing whatever mesh the chunk had before
+void uploadChunkMesh(ChunkCoord coord, const std::vector<PackedVertex>& vertices, MeshMode mode, ChunkMeshMap& meshes = chunkMeshes) {
+    if (vertices.empty()) {
+        deleteChunkMesh(coord, meshes);
+        return;
+    }
+    auto it = meshes.find(coord);
+    if (it == meshes.end()) {
+        ChunkMesh mesh;
+        glGenVertexArrays(1, &mesh.VAO);
+        glGenBuffers(1, &mesh.VBO);
+        glBindVertexArray(mesh.VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+        // Both words are read as unsigned ints, glVertexAttribIPointer stops them being turned into floats
+        glVertexAttribIPointer(0, 2, GL_UNSIGNED_INT, sizeof(PackedVertex), (void*)0);
+        glEnableVertexAttribArray(0);
+        glBindVertexArray(0);
+        it = meshes.emplace(coord, mesh).first;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, it->second.VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(PackedVertex), vertices.data(), GL_STATIC_DRAW);
+    it->second.vertexCount = (int)vertices.size();
+    it->second.mode = mode;
+}
+
+// Chunks whose blocks have changed since they were last meshed
+std::unordered_set<ChunkCoord, ChunkCoordHash> dirtyChunks;
+// Chunks whose blocks are fine but whose mesh was made in a mode that is no longer used
+std::unordered_set<ChunkCoord, ChunkCoordHash> staleChunks;
+
+// Most chunks meshed in one frame, so remeshing the whole world is spread over several frames instead of stalling one
+#define REMESH_CHUNKS_PER_FRAME 16
+
+/*
+Marks the chunk a block is in as needing a new mesh. A block on the edge of a chunk also decides whether the faces of the
+block next to it in the neighbouring chunk are drawn, so that neighbour is marked as well.
+*/
+void markBlockDirty(int x, int z) {
+    ChunkCoord coord = VoxelWorld::chunkCoordOf(x, z);
+    dirtyChunks.insert(coord);
+    int localX = floorMod(x, CHUNK_SIZE);
+    int localZ = floorMod(z, CHUNK_SIZE);
+    if (localX == 0) dirtyChunks.insert({ coord.x - 1, coord.z });
+    if (localX == CHUNK_SIZE - 1) dirtyChunks.insert({ coord.x + 1, coord.z });
+    if (localZ == 0) dirtyChunks.insert({ coord.x, coord.z - 1 });
+    if (localZ == CHUNK_SIZE - 1) dirtyChunks.insert({ coord.x, coord.z + 1 });
+}
+
+// Marks every mesh that wasn't made in the current mode, for when the mode changes or a world made in another mode is swapped in
+void markStaleMeshes(const ChunkMeshMap& meshes = chunkMeshes) {
+    for (const auto& entry : meshes) {
+        if (entry.second.mode != chunkMeshMode) {
+            staleChunks.insert(entry.first);
+        }
+    }
+}
+
+/*
+Meshes and uploads up to maxChunks of the chunks that have been marked, done once a frame so several edits in a frame
+only mesh once. Edited chunks go before stale ones so an edit shows up straight away even while the whole world is being
+remeshed for a new mode. Whatever is left stays marked for the next frame. Returns how many are still waiting.
+*/
+size_t remeshDirtyChunks(const VoxelWorld& world, size_t maxChunks = REMESH_CHUNKS_PER_FRAME) {
+    std::vector<PackedVertex> vertices;
+    size_t meshed = 0;
+    for (std::unordered_set<ChunkCoord, ChunkCoordHash>* chunks : { &dirtyChunks, &staleChunks }) {
+        for (auto it = chunks->begin(); it != chunks->end() && meshed < maxChunks; it = chunks->erase(it)) {
+            const Chunk* chunk = world.getChunk(*it);
+            if (!chunk) {
+                continue; // A neighbour that isn't loaded has no mesh to fix
+            }
+            // Remeshing a chunk for an edit also brings it up to the current mode
+            auto mesh = chunkMeshes.find(*it);
+            if (chunks == &staleChunks && mesh != chunkMeshes.end() && mesh->second.mode == chunkMeshMode) {
+                continue;
+            }
+            meshChunk(world, *chunk, vertices, chunkMeshMode);
+            uploadChunkMesh(*it, vertices, chunkMeshMode);
+            meshed++;
+        }
+    }
+    return dirtyChunks.size() + staleChunks.size();
+}
+
+void drawChunks(Shader& shader) {
+    shader.use();
+    // Every vertex carries its texture layer, so the one texture array covers every block type
+    glBindTexture(GL_TEXTURE_2D_ARRAY, blockTextureArray);
+    Uniform<glm::vec3> chunkOrigin = shader.uniform<glm::vec3>("chunkOrigin");
+    for (auto& entry : chunkMeshes) {
+        shader.set(chunkOrigin, glm::vec3(entry.first.x * CHUNK_SIZE, 0.0f, entry.first.z * CHUNK_SIZE));
+        glBindVertexArray(entry.second.VAO);
+        glDrawArrays(GL_TRIANGLES, 0, entry.second.vertexCount);
+    }
+    glBindVertexArray(0);
+}
+
+#endif
@@ -0,0 +1,372 @@
+#ifndef CHUNKSTREAMER_H
+#define CHUNKSTREAMER_H
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <glm/glm.hpp>
+#include "threadPool.h"
+#include "lockFreeQueue.h"
+#include "terrain.h"
+#include "chunkRenderer.h"
+
+// A chunk a worker has finished generating and meshing, waiting to be added to the world
+struct StreamedChunk
+{
+    std::unique_ptr<Chunk> chunk;
+    std::vector<PackedVertex> vertices;
+    MeshStats stats;
+    MeshMode mode;
+    int generation;
+};
+
+// A new world being built in the background while the old one is still being drawn
+struct StagedWorld
+{
+    std::shared_ptr<VoxelWorld> world = std::make_shared<VoxelWorld>();
+    ChunkMeshMap meshes;
+    TerrainSettings settings;
+};
+
+/*
+Keeps the chunks within radius chunks of the camera loaded, so the world goes on forever without all of it being in memory.
+Missing chunks are generated and meshed on the pool's workers, closest first, and handed back through a lock free queue
+that update() empties on the render thread. Only a few finished chunks are uploaded each frame and chunks further than
+radius + 1 away are thrown out, the extra chunk stops chunks on the edge being loaded and evicted over and over.
+
+Chunks that have been edited are never made again from the terrain. When one goes out of range it is put aside instead
+of being freed and comes back as it was when the camera returns, and chunks loaded next to one are remeshed against it.
+
+regenerate() builds a whole new world around the camera the same way but keeps it to one side, the old world carries on
+being drawn until every chunk in range is ready and then the two are swapped between frames. Calling it again before
+that cancels the world being built. Everything apart from the workers' tasks happens on the render thread.
+*/
+class ChunkStreamer
+{
+public:
+    int radius;
+    int maxUploadsPerFrame = 4;
+    // Meshes of worlds that are no longer used are deleted a few at a time so a swap doesn't cost a frame
+    int maxMeshDeletesPerFrame = 32;
+    // Set whenever chunks are added or removed, for anything else built from the world (the instanced cubes)
+    bool worldChanged = false;
+    size_t chunksLoaded = 0;
+    size_t chunksEvicted = 0;
+
+    ChunkStreamer(ThreadPool& pool, VoxelWorld& world, int radius = 8) : radius(radius), pool(pool), world(world) {
+        // Enough to keep every worker busy while not queueing so much that the camera moving makes most of it useless
+        maxInFlight = pool.workerCount() * 2;
+    }
+
+    // Drops every chunk straight away and starts streaming the new terrain in, closest chunks first
+    void restart(const TerrainSettings& newSettings) {
+        cancelRegeneration();
+        settings = newSettings;
+        startGeneration();
+        world.clear();
+        clearChunkMeshes();
+        forgetEdits();
+        started = true;
+        worldChanged = true;
+    }
+
+    // Starts building a world with new terrain in the background, it replaces the current one once it is ready
+    void regenerate(const TerrainSettings& newSettings) {
+        if (!started) {
+            restart(newSettings);
+            return;
+        }
+        cancelRegeneration();
+        staged = std::make_unique<StagedWorld>();
+        staged->settings = newSettings;
+        startGeneration();
+    }
+
+    // Called after a block in the chunk changes, so the chunk is kept rather than generated again once it leaves range
+    void chunkEdited(ChunkCoord coord) {
+        editedChunks.insert(coord);
+        worldChanged = true;
+    }
+
+    bool isRegenerating() const {
+        return staged != nullptr;
+    }
+
+    // Called once a frame with the camera's position
+    void update(glm::vec3 position) {
+        deleteRetiredMeshes();
+        if (!started) {
+            return;
+        }
+        ChunkCoord camera = chunkCoordAt(position);
+        if (!(camera == centre)) {
+            centre = camera;
+            evictDistantChunks(world, chunkMeshes);
+            if (staged) {
+                evictDistantChunks(*staged->world, staged->meshes);
+            }
+            needsScan = true;
+        }
+        receiveChunks();
+        if (needsScan && (int)pending.size() < maxInFlight) {
+            requestMissingChunks();
+        }
+        if (staged && pending.empty() && !needsScan) {
+            swapInStagedWorld();
+        }
+    }
+
+    // True once the chunk the position is in has been loaded, nothing should fall through the world before then
+    bool isLoaded(glm::vec3 position) const {
+        return world.getChunk(chunkCoordAt(position)) != nullptr;
+    }
+
+    size_t pendingCount() const {
+        return pending.size();
+    }
+
+private:
+    ThreadPool& pool;
+    VoxelWorld& world;
+    TerrainSettings settings;
+    int maxInFlight;
+    bool started = false;
+    bool needsScan = false;
+    ChunkCoord centre = { 0, 0 };
+    // Only results from the newest generation are kept, bumping it cancels everything that was asked for before
+    int generation = 0;
+    // Shared with the tasks, so tasks for old terrain can skip their work and the queue outlives the streamer if tasks are still running
+    std::shared_ptr<std::atomic<int>> currentGeneration = std::make_shared<std::atomic<int>>(0);
+    std::shared_ptr<LockFreeQueue<StreamedChunk>> finished = std::make_shared<LockFreeQueue<StreamedChunk>>();
+    std::unordered_set<ChunkCoord, ChunkCoordHash> pending;
+    std::unique_ptr<StagedWorld> staged;
+    std::vector<ChunkMesh> retiredMeshes;
+    // Chunks of the live world that have been edited, and the ones of those that are out of range right now
+    std::unordered_set<ChunkCoord, ChunkCoordHash> editedChunks;
+    std::unordered_map<ChunkCoord, std::unique_ptr<Chunk>, ChunkCoordHash> savedChunks;
+
+    // Blocks are centred on whole numbers, so the block a position is in is found by rounding
+    static ChunkCoord chunkCoordAt(glm::vec3 position) {
+        return VoxelWorld::chunkCoordOf((int)floor(position.x + 0.5f), (int)floor(position.z + 0.5f));
+    }
+
+    int distanceSquared(ChunkCoord coord) const {
+        int dx = coord.x - centre.x;
+        int dz = coord.z - centre.z;
+        return dx * dx + dz * dz;
+    }
+
+    bool inRange(ChunkCoord coord, int range) const {
+        return distanceSquared(coord) <= range * range;
+    }
+
+    // The world new chunks go into, the staged one while regenerating
+    VoxelWorld& targetWorld() {
+        return staged ? *staged->world : world;
+    }
+
+    ChunkMeshMap& targetMeshes() {
+        return staged ? staged->meshes : chunkMeshes;
+    }
+
+    const TerrainSettings& targetSettings() const {
+        return staged ? staged->settings : settings;
+    }
+
+    // Edits belong to the terrain they were made on, so they go when the terrain is replaced
+    void forgetEdits() {
+        editedChunks.clear();
+        savedChunks.clear();
+    }
+
+    /*
+    The mesher looks one block into the chunks on each side, so when a chunk arrives next to an edited one the two meshes
+    were made against different blocks along their shared side. Both are marked to be remeshed from the world as it is.
+    */
+    void markEditedNeighbours(ChunkCoord coord) {
+        const ChunkCoord sides[4] = { { coord.x - 1, coord.z }, { coord.x + 1, coord.z }, { coord.x, coord.z - 1 }, { coord.x, coord.z + 1 } };
+        for (ChunkCoord side : sides) {
+            if (editedChunks.count(side) != 0 && world.getChunk(side)) {
+                dirtyChunks.insert(coord);
+                dirtyChunks.insert(side);
+            }
+        }
+    }
+
+    // Puts an edited chunk back into the world, it has no mesh yet so it and its neighbours are remeshed
+    void restoreSavedChunk(ChunkCoord coord) {
+        auto it = savedChunks.find(coord);
+        world.insertChunk(std::move(it->second));
+        savedChunks.erase(it);
+        dirtyChunks.insert(coord);
+        dirtyChunks.insert({ coord.x - 1, coord.z });
+        dirtyChunks.insert({ coord.x + 1, coord.z });
+        dirtyChunks.insert({ coord.x, coord.z - 1 });
+        dirtyChunks.insert({ coord.x, coord.z + 1 });
+        chunksLoaded++;
+        worldChanged = true;
+    }
+
+    void startGeneration() {
+        generation++;
+        currentGeneration->store(generation, std::memory_order_relaxed);
+        pending.clear();
+        needsScan = true;
+    }
+
+    void retireMeshes(ChunkMeshMap& meshes) {
+        for (auto& entry : meshes) {
+            retiredMeshes.push_back(entry.second);
+        }
+        meshes.clear();
+    }
+
+    void deleteRetiredMeshes() {
+        int count = std::min((int)retiredMeshes.size(), maxMeshDeletesPerFrame);
+        for (int i = 0; i < count; i++) {
+            destroyChunkMesh(retiredMeshes.back());
+            retiredMeshes.pop_back();
+        }
+    }
+
+    /*
+    Freeing thousands of chunks takes a while, so the last reference to an old world is dropped on a worker instead.
+    Callers move their pointer in, a copy left behind could end up being the last one and free the world right here.
+    */
+    void releaseInBackground(std::shared_ptr<VoxelWorld> oldWorld) {
+        pool.submit([oldWorld = std::move(oldWorld)]() mutable {
+            oldWorld.reset();
+        });
+    }
+
+    void cancelRegeneration() {
+        if (!staged) {
+            return;
+        }
+        retireMeshes(staged->meshes);
+        releaseInBackground(std::move(staged->world));
+        staged.reset();
+        // The tasks for the cancelled world are skipped, the live world picks up streaming where it left off
+        startGeneration();
+    }
+
+    void swapInStagedWorld() {
+        world.swap(*staged->world);
+        chunkMeshes.swap(staged->meshes);
+        settings = staged->settings;
+        // The staged world and meshes now hold what used to be drawn, including the old live world's chunks
+        retireMeshes(staged->meshes);
+        releaseInBackground(std::move(staged->world));
+        staged.reset();
+        forgetEdits();
+        // Anything that was built before the mesh mode last changed gets remeshed now it is the live world
+        markStaleMeshes();
+        worldChanged = true;
+        needsScan = true;
+    }
+
+    void evictDistantChunks(VoxelWorld& from, ChunkMeshMap& meshes) {
+        std::vector<ChunkCoord> distant;
+        from.forEachChunk([&](const Chunk& chunk) {
+            if (!inRange(chunk.coord, radius + 1)) {
+                distant.push_back(chunk.coord);
+            }
+        });
+        for (ChunkCoord coord : distant) {
+            std::unique_ptr<Chunk> chunk = from.removeChunk(coord);
+            if (&from == &world && editedChunks.count(coord) != 0) {
+                savedChunks[coord] = std::move(chunk);
+            }
+            deleteChunkMesh(coord, meshes);
+        }
+        chunksEvicted += distant.size();
+        if (!distant.empty() && &from == &world) {
+            worldChanged = true;
+        }
+    }
+
+    void receiveChunks() {
+        StreamedChunk result;
+        int uploads = 0;
+        while (uploads < maxUploadsPerFrame && finished->pop(result)) {
+            if (result.generation != generation) {
+                continue;
+            }
+            ChunkCoord coord = result.chunk->coord;
+            pending.erase(coord);
+            needsScan = true;
+            // The camera may have moved away while the chunk was being made
+            if (!inRange(coord, radius + 1)) {
+                continue;
+            }
+            targetWorld().insertChunk(std::move(result.chunk));
+            uploadChunkMesh(coord, result.vertices, result.mode, targetMeshes());
+            chunksLoaded++;
+            if (!staged) {
+                // Asked for before the mesh mode changed, so it missed being marked along with the rest of the world
+                if (result.mode != chunkMeshMode) {
+                    staleChunks.insert(coord);
+                }
+                markEditedNeighbours(coord);
+                worldChanged = true;
+            }
+            uploads++;
+        }
+    }
+
+    void requestMissingChunks() {
+        const VoxelWorld& target = targetWorld();
+        std::vector<ChunkCoord> missing;
+        for (int z = centre.z - radius; z <= centre.z + radius; z++) {
+            for (int x = centre.x - radius; x <= centre.x + radius; x++) {
+                ChunkCoord coord = { x, z };
+                if (!inRange(coord, radius) || target.getChunk(coord) || pending.count(coord) != 0) {
+                    continue;
+                }
+                // Edited chunks come straight back without a worker, a staged world has new terrain so doesn't use them
+                if (!staged && savedChunks.count(coord) != 0) {
+                    restoreSavedChunk(coord);
+                }
+                else {
+                    missing.push_back(coord);
+                }
+            }
+        }
+        std::sort(missing.begin(), missing.end(), [&](ChunkCoord a, ChunkCoord b) {
+            return distanceSquared(a) < distanceSquared(b);
+        });
+
+        size_t slots = (size_t)(maxInFlight - (int)pending.size());
+        size_t count = std::min(slots, missing.size());
+        for (size_t i = 0; i < count; i++) {
+            submitChunk(missing[i]);
+        }
+        // Once everything in range has been asked for there is nothing to look for until a chunk arrives or the camera moves
+        needsScan = count < missing.size();
+    }
+
+    void submitChunk(ChunkCoord coord) {
+        pending.insert(coord);
+        std::shared_ptr<LockFreeQueue<StreamedChunk>> queue = finished;
+        std::shared_ptr<std::atomic<int>> current = currentGeneration;
+        TerrainSettings terrain = targetSettings();
+        MeshMode mode = chunkMeshMode;
+        int taskGeneration = generation;
+        pool.submit([queue, current, terrain, mode, taskGeneration, coord]() {
+            if (current->load(std::memory_order_relaxed) != taskGeneration) {
+                return;
+            }
+            StreamedChunk result;
+            result.chunk = generateChunk(coord, terrain);
+            result.stats = meshGeneratedChunk(*result.chunk, terrain, mode, result.vertices);
+            result.mode = mode;
+            result.generation = taskGeneration;
+            queue->push(std::move(result));
+        });
+    }
+};
+
+#endif
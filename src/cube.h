@@ -1,3 +1,6 @@
+#ifndef CUBE_H
+#define CUBE_H
+
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
@@ -5,7 +8,10 @@
 #include <glfw/glfw3.h>
 #include <vector>
 #include "shader.h"
+#include "world.h"
+#include "mesher.h"
 
+// The layers of the block texture array, in the same order as the block IDs after air
 enum TextureID
 {
     DIRT,
@@ -68,44 +74,28 @@ unsigned int cubeIndices[] = {
     20, 21, 22, 22, 23, 20   // bottom
 };
 
-unsigned int textures[3];
-std::vector<glm::vec3> instancePositions;
-
-class cube {
-public:
-    glm::vec3 position;
-    TextureID textureID;
-
-    unsigned int* VAO;
-    unsigned int* VBO;
-    Shader* cubeShader;
-    unsigned int* instanceVBO;
-
-    cube(glm::vec3 pos, TextureID texID, Shader* shader, unsigned int* vao, unsigned int* vbo, std::vector<cube*>cubes) {
-        position = pos;
-        textureID = texID;
+// Every block texture as one GL_TEXTURE_2D_ARRAY, indexed by TextureID
+unsigned int blockTextureArray;
+std::vector<BlockInstance> blockInstances;
+// Where blockInstances starts in the instance upload ring, counted in instances
+unsigned int instanceBase = 0;
 
-        VAO = vao;
-        VBO = vbo;
-
-        instancePositions.push_back(pos);
-        cubes.push_back(this);
-    }
-
-    void updateInstanceData() {
-        glBindBuffer(GL_ARRAY_BUFFER, *instanceVBO);
-        glBufferData(GL_ARRAY_BUFFER, instancePositions.size() * sizeof(glm::vec3), instancePositions.data(), GL_DYNAMIC_DRAW);
-    }
+// The blocks in the world, this is what everything else (drawing, collisions) reads from
+VoxelWorld world;
 
-    glm::vec3 getMinBounds() {
-        return position - glm::vec3(0.5f, 0.5f, 0.5f);
-    }
-
-    glm::vec3 getMaxBounds() {
-        return position + glm::vec3(0.5f, 0.5f, 0.5f);
-    }
+// How many blocks the world has and how many of them were actually sent to be drawn
+struct InstanceStats {
+    size_t totalBlocks;
+    size_t emittedBlocks;
 };
-std::vector<cube*> cubes;
+InstanceStats instanceStats;
+
+// Fills blockInstances with every block that can be seen, blocks buried on all six sides are skipped
+InstanceStats buildInstances(const VoxelWorld& world) {
+    instanceStats.totalBlocks = buildBlockInstances(world, blockInstances);
+    instanceStats.emittedBlocks = blockInstances.size();
+    return instanceStats;
+}
 
 void drawWorld(unsigned int VAO, Shader* shader) {
     if (!shader) {
@@ -116,13 +106,11 @@ void drawWorld(unsigned int VAO, Shader* shader) {
     shader->use();
     glBindVertexArray(VAO);
 
-    // Bind a default texture (or modify shader to handle multiple textures per instance)
-    glBindTexture(GL_TEXTURE_2D, textures[DIRT]); // Example texture
-
-    // Draw all instances
-    glDrawArraysInstanced(GL_TRIANGLES, 0, 36, instancePositions.size());
+    // Each instance picks its own layer, so every block type is drawn by this one call
+    glBindTexture(GL_TEXTURE_2D_ARRAY, blockTextureArray);
+    glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 36, blockInstances.size(), instanceBase);
 
     glBindVertexArray(0);
 }
 
-
+#endif
@@ -0,0 +1,272 @@
+#ifndef FRAMEUNIFORMS_H
+#define FRAMEUNIFORMS_H
+
+#include <glad/glad.h>
+#include <math.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include "std140.h"
+
+// Binding point of the FrameData uniform block in lighting.vs, chunk.vs and lighting.fs, shared by every shader that uses it
+#define FRAME_DATA_BINDING 0
+// Binding point of the LightData storage buffer in lighting.fs, set in the shader with layout(binding = 1)
+#define LIGHT_DATA_BINDING 1
+
+struct DirectionalLight
+{
+    glm::vec3 direction;
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+};
+
+// Everything in the FrameData block, it is the same for every shader drawn in a frame
+struct FrameData
+{
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPos;
+    float shininess;
+    DirectionalLight sun;
+    int pointLightCount;
+    bool blinn;
+    bool gamma;
+    // Finds the light cluster a fragment is in, see LightClusters in lightClusters.h
+    float clusterZScale;
+    glm::vec2 clusterTileScale;
+    float clusterZBias;
+};
+
+// One element of pointLights in the LightData storage buffer
+struct PointLightData
+{
+    glm::vec3 position;
+    float constant;
+    float linear;
+    float quadratic;
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+};
+
+// Bytes in the FrameData block, what packFrameData writes
+#define FRAME_DATA_SIZE 224
+
+// Each PointLightData takes this many bytes in the buffer, a struct is padded out to a multiple of 16
+#define POINT_LIGHT_STRIDE 80
+
+/*
+How far a point light reaches, the distance where its brightest colour has faded to 5/256 of itself. Past this the light
+is left out of the clusters, which is too little to see.
+*/
+float pointLightRadius(const PointLightData& light) {
+    glm::vec3 brightest = glm::max(light.ambient, glm::max(light.diffuse, light.specular));
+    float brightness = fmaxf(brightest.x, fmaxf(brightest.y, brightest.z));
+    float cutoff = light.constant - brightness * (256.0f / 5.0f);
+    if (cutoff >= 0.0f) {
+        return 0.0f; // Never gets bright enough to see
+    }
+    if (light.quadratic <= 0.0f) {
+        return light.linear > 0.0f ? -cutoff / light.linear : INFINITY;
+    }
+    return (-light.linear + sqrtf(light.linear * light.linear - 4.0f * light.quadratic * cutoff)) / (2.0f * light.quadratic);
+}
+
+/*
+Writes the FrameData block. The members are in the same order as the block declares them, the sun is split into vec3s
+with the smaller members tucked into the end of each one so the whole block is 224 bytes with nothing wasted.
+*/
+size_t packFrameData(const FrameData& frame, std::vector<uint8_t>& out) {
+    Std140Writer writer(out);
+    writer.write(frame.projection);
+    writer.write(frame.view);
+    writer.write(frame.viewPos);
+    writer.write(frame.shininess);
+    writer.write(frame.sun.direction);
+    writer.write(frame.pointLightCount);
+    writer.write(frame.sun.ambient);
+    writer.write(frame.blinn);
+    writer.write(frame.sun.diffuse);
+    writer.write(frame.gamma);
+    writer.write(frame.sun.specular);
+    writer.write(frame.clusterZScale);
+    writer.write(frame.clusterTileScale);
+    writer.write(frame.clusterZBias);
+    return writer.align(16);
+}
+
+/*
+Writes one element of the pointLights array, taking POINT_LIGHT_STRIDE bytes. The buffer is std430, which only differs
+from std140 for arrays and structs made of scalars, so this struct is laid out the same either way.
+*/
+void writePointLight(Std140Writer& writer, const PointLightData& light) {
+    writer.beginStruct();
+    writer.write(light.position);
+    writer.write(light.constant);
+    writer.write(light.linear);
+    writer.write(light.quadratic);
+    writer.write(light.ambient);
+    writer.write(light.diffuse);
+    writer.write(light.specular);
+    writer.endStruct();
+}
+
+/*
+A buffer bound to a uniform block binding point. Like Shader it is made with create() once there is a context, so it
+can be a global.
+*/
+class UniformBuffer
+{
+public:
+    unsigned int ID = 0;
+
+    void create(size_t size, unsigned int binding) {
+        capacity = size;
+        glGenBuffers(1, &ID);
+        glBindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+    }
+
+    // Replaces size bytes starting at offset, anything past the end of the buffer is left off
+    void update(const void* data, size_t size, size_t offset = 0) {
+        if (offset >= capacity || size == 0) {
+            return;
+        }
+        size = size < capacity - offset ? size : capacity - offset;
+        glBindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+    }
+
+    void update(const std::vector<uint8_t>& data, size_t offset = 0) {
+        update(data.data(), data.size(), offset);
+    }
+
+    void destroy() {
+        if (ID) {
+            glDeleteBuffers(1, &ID);
+            ID = 0;
+        }
+    }
+
+private:
+    size_t capacity = 0;
+};
+
+/*
+A shader storage buffer bound to a binding point. Unlike a uniform block it can be any size, so the shader doesn't need
+to know how much is in it when it is compiled. resize() throws away what was in it.
+*/
+class StorageBuffer
+{
+public:
+    unsigned int ID = 0;
+
+    void create(size_t size, unsigned int binding) {
+        this->binding = binding;
+        glGenBuffers(1, &ID);
+        resize(size);
+    }
+
+    void resize(size_t size) {
+        capacity = size > 0 ? size : 4;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, ID);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity, NULL, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, ID);
+    }
+
+    size_t size() const {
+        return capacity;
+    }
+
+    // Replaces size bytes starting at offset, anything past the end of the buffer is left off
+    void update(const void* data, size_t size, size_t offset = 0) {
+        if (offset >= capacity || size == 0) {
+            return;
+        }
+        size = size < capacity - offset ? size : capacity - offset;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, ID);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset, size, data);
+    }
+
+    void update(const std::vector<uint8_t>& data, size_t offset = 0) {
+        update(data.data(), data.size(), offset);
+    }
+
+    void destroy() {
+        if (ID) {
+            glDeleteBuffers(1, &ID);
+            ID = 0;
+        }
+    }
+
+private:
+    size_t capacity = 0;
+    unsigned int binding = 0;
+};
+
+/*
+A buffer read in shaders through a buffer texture (samplerBuffer), for lists too big for a uniform block. Made with
+create() once there is a context like UniformBuffer, and it grows when more is written than it holds.
+*/
+class TextureBuffer
+{
+public:
+    unsigned int ID = 0;
+    unsigned int texture = 0;
+
+    // format is what each texel is read as, GL_R32UI for a list of unsigned ints
+    void create(GLenum format, size_t size) {
+        glGenBuffers(1, &ID);
+        allocate(size > 0 ? size : 4);
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, ID);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    void update(const void* data, size_t size) {
+        if (size == 0) {
+            return;
+        }
+        if (size > capacity) {
+            // The texture follows the buffer to its new storage, so it doesn't have to be attached again
+            size_t grown = capacity;
+            while (grown < size) {
+                grown *= 2;
+            }
+            allocate(grown);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, ID);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+    }
+
+    // Binds the texture to a texture unit and goes back to unit 0, which the block textures use
+    void bind(int unit) const {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    void destroy() {
+        if (texture) {
+            glDeleteTextures(1, &texture);
+            texture = 0;
+        }
+        if (ID) {
+            glDeleteBuffers(1, &ID);
+            ID = 0;
+        }
+    }
+
+private:
+    size_t capacity = 0;
+
+    void allocate(size_t size) {
+        capacity = size;
+        glBindBuffer(GL_TEXTURE_BUFFER, ID);
+        glBufferData(GL_TEXTURE_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+    }
+};
+
+#endif
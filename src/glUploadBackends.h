@@ -0,0 +1,129 @@
+#ifndef GLUPLOADBACKENDS_H
+#define GLUPLOADBACKENDS_H
+
+#include <glad/glad.h>
+#include <memory>
+#include <vector>
+#include "uploadRing.h"
+
+// Fences are the same for both backends, GL 3.2 has them so they don't need buffer storage
+inline UploadFence insertGLFence() {
+    return (UploadFence)glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+inline bool waitGLFence(UploadFence fence, uint64_t timeout) {
+    GLenum result = glClientWaitSync((GLsync)fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    // A failed wait won't ever succeed, so it is treated as passed rather than waiting forever
+    return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED;
+}
+
+/*
+An immutable buffer made with glBufferStorage (GL 4.4 / ARB_buffer_storage) and mapped once for as long as it lives.
+The mapping is coherent, so anything written through the pointer is seen by the GPU without flushing.
+*/
+class PersistentUploadBackend : public UploadBackend
+{
+public:
+    ~PersistentUploadBackend() {
+        release();
+    }
+
+    uint8_t* allocate(size_t size) override {
+        release();
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glGenBuffers(1, &name);
+        glBindBuffer(GL_ARRAY_BUFFER, name);
+        glBufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+        return (uint8_t*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+    }
+
+    void flush(size_t, size_t) override {}
+
+    UploadFence insertFence() override {
+        return insertGLFence();
+    }
+
+    bool waitFence(UploadFence fence, uint64_t timeout) override {
+        return waitGLFence(fence, timeout);
+    }
+
+    void deleteFence(UploadFence fence) override {
+        glDeleteSync((GLsync)fence);
+    }
+
+    unsigned int buffer() const override {
+        return name;
+    }
+
+private:
+    unsigned int name = 0;
+
+    void release() {
+        if (name) {
+            glBindBuffer(GL_ARRAY_BUFFER, name);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            glDeleteBuffers(1, &name);
+            name = 0;
+        }
+    }
+};
+
+/*
+For drivers without buffer storage. Writes go into ordinary memory and flush copies just the written range into the
+buffer with glBufferSubData, the buffer itself is only ever sized once so it is never orphaned or reallocated per write.
+*/
+class FallbackUploadBackend : public UploadBackend
+{
+public:
+    ~FallbackUploadBackend() {
+        if (name) {
+            glDeleteBuffers(1, &name);
+        }
+    }
+
+    uint8_t* allocate(size_t size) override {
+        if (name) {
+            glDeleteBuffers(1, &name);
+        }
+        staging.assign(size, 0);
+        glGenBuffers(1, &name);
+        glBindBuffer(GL_ARRAY_BUFFER, name);
+        glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+        return staging.data();
+    }
+
+    void flush(size_t offset, size_t size) override {
+        glBindBuffer(GL_ARRAY_BUFFER, name);
+        glBufferSubData(GL_ARRAY_BUFFER, offset, size, staging.data() + offset);
+    }
+
+    UploadFence insertFence() override {
+        return insertGLFence();
+    }
+
+    bool waitFence(UploadFence fence, uint64_t timeout) override {
+        return waitGLFence(fence, timeout);
+    }
+
+    void deleteFence(UploadFence fence) override {
+        glDeleteSync((GLsync)fence);
+    }
+
+    unsigned int buffer() const override {
+        return name;
+    }
+
+private:
+    unsigned int name = 0;
+    std::vector<uint8_t> staging;
+};
+
+// Picks the persistent backend when the driver has buffer storage and the fallback otherwise
+inline std::unique_ptr<UploadBackend> createUploadBackend() {
+    if (GLAD_GL_VERSION_4_4) {
+        return std::make_unique<PersistentUploadBackend>();
+    }
+    return std::make_unique<FallbackUploadBackend>();
+}
+
+#endif
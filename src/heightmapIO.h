@@ -0,0 +1,386 @@
+#ifndef HEIGHTMAPIO_H
+#define HEIGHTMAPIO_H
+
+#include <functional>
+#include "perlin.h"
+
+// How each height is stored in raw and .hmap files
+typedef enum {
+    HEIGHT_UINT8,   // 0 to 255
+    HEIGHT_UINT16,  // 0 to 65535
+    HEIGHT_FLOAT32  // The height as it is, from 0 to 1
+} HeightFormat;
+
+int heightFormatSize(HeightFormat format) {
+    return format == HEIGHT_UINT8 ? 1 : (format == HEIGHT_UINT16 ? 2 : 4);
+}
+
+// Turns heights into bytes in the given format, multi byte values are stored little endian
+void encodeHeights(const float* heights, size_t count, HeightFormat format, std::vector<uint8_t>& out) {
+    out.resize(count * heightFormatSize(format));
+    for (size_t i = 0; i < count; i++) {
+        if (format == HEIGHT_UINT8) {
+            out[i] = heightToByte(heights[i]);
+        }
+        else if (format == HEIGHT_UINT16) {
+            uint16_t value = heightToUint16(heights[i]);
+            out[i * 2 + 0] = (uint8_t)(value & 0xFF);
+            out[i * 2 + 1] = (uint8_t)(value >> 8);
+        }
+        else {
+            uint32_t bits;
+            memcpy(&bits, &heights[i], 4);
+            for (int b = 0; b < 4; b++) {
+                out[i * 4 + b] = (uint8_t)(bits >> (b * 8));
+            }
+        }
+    }
+}
+
+/*
+Receives a heightmap a band of rows at a time, so heightmaps far bigger than memory can be generated and saved.
+Rows are given as heights from 0 to 1 at full precision and it is up to each sink to turn them into whatever it stores.
+*/
+class HeightmapSink
+{
+public:
+    virtual ~HeightmapSink() {}
+    // Called once before any rows, returns false if the sink can't be written to
+    virtual bool begin(int width, int height) = 0;
+    // rows holds rowCount rows of width heights each, starting at row startY. Bands always arrive in order from the top.
+    virtual void writeRows(const float* rows, int startY, int rowCount) = 0;
+    virtual void end() = 0;
+};
+
+// Writes the rows as an 8 bit bitmap, which stores its rows top to bottom so each band can be appended as it arrives
+class BmpSink : public HeightmapSink
+{
+public:
+    BmpSink(const char* filename, BmpFormat format = BMP_GRAYSCALE8) : filename(filename), format(format) {}
+
+    bool begin(int width, int height) override {
+        layout = createBMPLayout(width, height, format);
+        // The bitmap header only has room for 32 bit sizes, most readers still open bigger files but some won't
+        if (layout.fileSize > UINT32_MAX) {
+            printf("Warning: %s is over 4GB, some programs won't open it\n", filename);
+        }
+        file = fopen(filename, "wb");
+        if (!file) {
+            perror("Failed to create file!\n");
+            return false;
+        }
+        std::vector<uint8_t> header(layout.headerSize);
+        writeBMPHeader(header.data(), layout);
+        fwrite(header.data(), 1, header.size(), file);
+        pixels.resize(layout.width);
+        return true;
+    }
+
+    void writeRows(const float* rows, int, int rowCount) override {
+        buffer.resize((size_t)layout.rowSize * rowCount);
+        for (int y = 0; y < rowCount; y++) {
+            for (int x = 0; x < layout.width; x++) {
+                pixels[x] = heightToByte(rows[(size_t)y * layout.width + x]);
+            }
+            encodeBMPRow(buffer.data() + (size_t)y * layout.rowSize, pixels.data(), layout);
+        }
+        fwrite(buffer.data(), 1, buffer.size(), file);
+    }
+
+    void end() override {
+        fclose(file);
+        file = NULL;
+    }
+
+private:
+    const char* filename;
+    BmpFormat format;
+    BmpLayout layout;
+    FILE* file = NULL;
+    std::vector<uint8_t> pixels;
+    std::vector<uint8_t> buffer;
+};
+
+// Writes the rows with no header, width * height values in total in the given format
+class RawSink : public HeightmapSink
+{
+public:
+    RawSink(const char* filename, HeightFormat format = HEIGHT_UINT8) : filename(filename), format(format) {}
+
+    bool begin(int width, int height) override {
+        this->width = width;
+        file = fopen(filename, "wb");
+        if (!file) {
+            perror("Failed to create file!\n");
+            return false;
+        }
+        writeHeader(width, height);
+        return true;
+    }
+
+    void writeRows(const float* rows, int, int rowCount) override {
+        encodeHeights(rows, (size_t)width * rowCount, format, buffer);
+        fwrite(buffer.data(), 1, buffer.size(), file);
+    }
+
+    void end() override {
+        fclose(file);
+        file = NULL;
+    }
+
+protected:
+    const char* filename;
+    HeightFormat format;
+    int width = 0;
+    FILE* file = NULL;
+    std::vector<uint8_t> buffer;
+
+    // Anything that needs to go in front of the heights, raw files have nothing
+    virtual void writeHeader(int, int) {}
+};
+
+// The header at the start of a .hmap file, the heights follow straight after it in the format given
+typedef struct {
+    char magic[4];     // "HMAP"
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;   // A HeightFormat
+} HeightFileHeader;
+
+#define HEIGHT_FILE_VERSION 1
+// Bytes the header takes up in the file, every field after the magic is stored little endian like the heights
+#define HEIGHT_FILE_HEADER_SIZE 20
+// Widest and tallest heightmap that will be loaded, anything bigger is taken to be a broken header
+#define MAX_HEIGHT_FILE_SIDE 16384
+
+void encodeHeightFileHeader(const HeightFileHeader& header, uint8_t* out) {
+    memcpy(out, header.magic, 4);
+    const uint32_t fields[4] = { header.version, header.width, header.height, header.format };
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 4; b++) {
+            out[4 + i * 4 + b] = (uint8_t)(fields[i] >> (b * 8));
+        }
+    }
+}
+
+void decodeHeightFileHeader(const uint8_t* data, HeightFileHeader& header) {
+    memcpy(header.magic, data, 4);
+    uint32_t fields[4];
+    for (int i = 0; i < 4; i++) {
+        fields[i] = 0;
+        for (int b = 0; b < 4; b++) {
+            fields[i] |= (uint32_t)data[4 + i * 4 + b] << (b * 8);
+        }
+    }
+    header.version = fields[0];
+    header.width = fields[1];
+    header.height = fields[2];
+    header.format = fields[3];
+}
+
+// Writes a raw file with a small header in front saying how big it is and how the heights are stored, readHeightFile loads these back
+class HeightFileSink : public RawSink
+{
+public:
+    HeightFileSink(const char* filename, HeightFormat format = HEIGHT_FLOAT32) : RawSink(filename, format) {}
+
+protected:
+    void writeHeader(int width, int height) override {
+        HeightFileHeader header;
+        memcpy(header.magic, "HMAP", 4);
+        header.version = HEIGHT_FILE_VERSION;
+        header.width = (uint32_t)width;
+        header.height = (uint32_t)height;
+        header.format = (uint32_t)format;
+        uint8_t bytes[HEIGHT_FILE_HEADER_SIZE];
+        encodeHeightFileHeader(header, bytes);
+        fwrite(bytes, 1, HEIGHT_FILE_HEADER_SIZE, file);
+    }
+};
+
+// Writes a binary PGM image, 16 bit by default which most image editors can open with the full precision
+class PgmSink : public HeightmapSink
+{
+public:
+    PgmSink(const char* filename, bool sixteenBit = true) : filename(filename), sixteenBit(sixteenBit) {}
+
+    bool begin(int width, int height) override {
+        this->width = width;
+        file = fopen(filename, "wb");
+        if (!file) {
+            perror("Failed to create file!\n");
+            return false;
+        }
+        fprintf(file, "P5\n%d %d\n%d\n", width, height, sixteenBit ? 65535 : 255);
+        return true;
+    }
+
+    void writeRows(const float* rows, int, int rowCount) override {
+        size_t count = (size_t)width * rowCount;
+        if (sixteenBit) {
+            // PGM stores 16 bit values most significant byte first
+            buffer.resize(count * 2);
+            for (size_t i = 0; i < count; i++) {
+                uint16_t value = heightToUint16(rows[i]);
+                buffer[i * 2 + 0] = (uint8_t)(value >> 8);
+                buffer[i * 2 + 1] = (uint8_t)(value & 0xFF);
+            }
+        }
+        else {
+            encodeHeights(rows, count, HEIGHT_UINT8, buffer);
+        }
+        fwrite(buffer.data(), 1, buffer.size(), file);
+    }
+
+    void end() override {
+        fclose(file);
+        file = NULL;
+    }
+
+private:
+    const char* filename;
+    bool sixteenBit;
+    int width = 0;
+    FILE* file = NULL;
+    std::vector<uint8_t> buffer;
+};
+
+// Hands every band to a function, for anything that wants the heights without saving them to a file
+class CallbackSink : public HeightmapSink
+{
+public:
+    CallbackSink(std::function<void(const float* rows, int width, int startY, int rowCount)> callback) : callback(callback) {}
+
+    bool begin(int width, int) override {
+        this->width = width;
+        return true;
+    }
+
+    void writeRows(const float* rows, int startY, int rowCount) override {
+        callback(rows, width, startY, rowCount);
+    }
+
+    void end() override {}
+
+private:
+    std::function<void(const float* rows, int width, int startY, int rowCount)> callback;
+    int width = 0;
+};
+
+// Passes a heightmap that is already in memory to a sink, so it can be saved in any of the formats above
+bool saveHeightmap(const Heightmap& heightmap, HeightmapSink& sink) {
+    if (!sink.begin(heightmap.width, heightmap.height)) {
+        return false;
+    }
+    sink.writeRows(heightmap.heights.data(), 0, heightmap.height);
+    sink.end();
+    return true;
+}
+
+/*
+Loads a .hmap file written by HeightFileSink, the heights come back from 0 to 1 as they were saved with no extra rounding.
+The size in the header is checked against the size of the file before anything is allocated, so a broken file can't ask
+for more memory than it holds.
+*/
+bool readHeightFile(const char* filename, Heightmap& heightmap) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        perror("Failed to open file!\n");
+        return false;
+    }
+    uint8_t headerBytes[HEIGHT_FILE_HEADER_SIZE];
+    HeightFileHeader header;
+    if (fread(headerBytes, 1, HEIGHT_FILE_HEADER_SIZE, file) != HEIGHT_FILE_HEADER_SIZE) {
+        printf("%s is not a heightmap file\n", filename);
+        fclose(file);
+        return false;
+    }
+    decodeHeightFileHeader(headerBytes, header);
+    if (memcmp(header.magic, "HMAP", 4) != 0 || header.version != HEIGHT_FILE_VERSION || header.format > HEIGHT_FLOAT32 ||
+        header.width == 0 || header.height == 0 || header.width > MAX_HEIGHT_FILE_SIDE || header.height > MAX_HEIGHT_FILE_SIDE) {
+        printf("%s is not a heightmap file\n", filename);
+        fclose(file);
+        return false;
+    }
+
+    HeightFormat format = (HeightFormat)header.format;
+    size_t count = (size_t)header.width * header.height;
+    size_t payload = count * heightFormatSize(format);
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, HEIGHT_FILE_HEADER_SIZE, SEEK_SET);
+    if (fileSize < 0 || (size_t)fileSize != HEIGHT_FILE_HEADER_SIZE + payload) {
+        printf("%s should hold %zu bytes of heights but is %ld bytes long\n", filename, payload, fileSize);
+        fclose(file);
+        return false;
+    }
+
+    std::vector<uint8_t> data(payload);
+    if (fread(data.data(), 1, data.size(), file) != data.size()) {
+        printf("%s is missing some of its heights\n", filename);
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+
+    heightmap.width = (int)header.width;
+    heightmap.height = (int)header.height;
+    heightmap.heights.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        if (format == HEIGHT_UINT8) {
+            heightmap.heights[i] = data[i] / 255.0f;
+        }
+        else if (format == HEIGHT_UINT16) {
+            heightmap.heights[i] = (uint16_t)(data[i * 2] | (data[i * 2 + 1] << 8)) / 65535.0f;
+        }
+        else {
+            uint32_t bits = 0;
+            for (int b = 0; b < 4; b++) {
+                bits |= (uint32_t)data[i * 4 + b] << (b * 8);
+            }
+            memcpy(&heightmap.heights[i], &bits, 4);
+        }
+    }
+    return true;
+}
+
+/*
+Generates the width x height heightmap starting at noise position (originX, originY) one band of rows at a time and passes
+each band to the sink before making the next one. Only one band is ever held in memory, so the memory used depends on
+width * bandHeight and not on the height of the image. If a pool is given each band is split into tiles across its
+workers, the values are the same either way. The sink sees rows numbered from 0 whatever the origin is.
+*/
+bool streamPerlinNoise(HeightmapSink& sink, float cellSize, int originX, int originY, int width, int height, int seed, GradientMode mode = GRADIENT_ANGLE,
+                       ThreadPool* pool = nullptr, const FractalSettings* fractal = nullptr, int bandHeight = PERLIN_TILE_SIZE) {
+    if (!sink.begin(width, height)) {
+        return false;
+    }
+    if (bandHeight < 1) {
+        bandHeight = 1;
+    }
+
+    std::vector<float> band((size_t)width * bandHeight);
+    for (int bandY = 0; bandY < height; bandY += bandHeight) {
+        int rows = height - bandY < bandHeight ? height - bandY : bandHeight;
+        if (pool) {
+            perlinNoiseRegionParallel(originX, originY + bandY, width, rows, cellSize, seed, mode, *pool, [&](const float* tile, int startX, int startY, int tileWidth, int tileHeight) {
+                for (int y = 0; y < tileHeight; y++) {
+                    memcpy(&band[(size_t)(startY - originY - bandY + y) * width + startX - originX], tile + y * PERLIN_TILE_SIZE, sizeof(float) * tileWidth);
+                }
+            }, fractal);
+        }
+        else {
+            noiseTile(band.data(), width, originX, originY + bandY, width, rows, cellSize, seed, mode, fractal);
+        }
+        for (size_t i = 0; i < (size_t)width * rows; i++) {
+            band[i] = noiseToHeight(band[i]);
+        }
+        sink.writeRows(band.data(), bandY, rows);
+    }
+
+    sink.end();
+    return true;
+}
+
+#endif
@@ -0,0 +1,328 @@
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "frameUniforms.h"
+
+// SSE2 is always there on x86-64, so unlike the perlin kernels this one needs no runtime check
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LIGHT_CLUSTERS_SSE 1
+#include <emmintrin.h>
+#endif
+
+/*
+The view frustum is cut into CLUSTER_COUNT_X x CLUSTER_COUNT_Y tiles across the screen and CLUSTER_COUNT_Z slices in depth.
+The slices get thicker further away (each one is the same ratio of far to near) so clusters stay roughly cube shaped.
+lighting.fs gets these numbers from clusterShaderDefines when it is compiled.
+*/
+#define CLUSTER_COUNT_X 16
+#define CLUSTER_COUNT_Y 9
+#define CLUSTER_COUNT_Z 24
+#define CLUSTERS_PER_SLICE (CLUSTER_COUNT_X * CLUSTER_COUNT_Y)
+#define CLUSTER_COUNT (CLUSTERS_PER_SLICE * CLUSTER_COUNT_Z)
+
+// The cluster counts as GLSL defines, passed to Shader::createShader for any shader that reads the clusters
+inline std::string clusterShaderDefines() {
+    return "#define CLUSTER_COUNT_X " + std::to_string(CLUSTER_COUNT_X) + "\n" +
+           "#define CLUSTER_COUNT_Y " + std::to_string(CLUSTER_COUNT_Y) + "\n" +
+           "#define CLUSTER_COUNT_Z " + std::to_string(CLUSTER_COUNT_Z) + "\n";
+}
+
+typedef enum {
+    LIGHT_CLUSTERS_SCALAR,
+    LIGHT_CLUSTERS_SIMD
+} LightClusterKernel; // Which implementation the sphere against cluster test uses.
+
+// This can be set to LIGHT_CLUSTERS_SCALAR to check the SSE kernel against it
+#ifdef LIGHT_CLUSTERS_SSE
+LightClusterKernel lightClusterKernel = LIGHT_CLUSTERS_SIMD;
+#else
+LightClusterKernel lightClusterKernel = LIGHT_CLUSTERS_SCALAR;
+#endif
+
+// The view space bounding box of every cluster, stored as one array per side so the tests can load four clusters at once
+struct ClusterBounds
+{
+    std::vector<float> minX, minY, minZ;
+    std::vector<float> maxX, maxY, maxZ;
+};
+
+/*
+Sphere tests. Each one checks clusters first up to first + count against the sphere at (x, y, z) with radius squared r2 and
+appends the index of every cluster it touches to hits. The distance from the centre to a box is worked out per axis as
+how far the centre is outside the box on that axis, which is 0 if it's inside.
+*/
+void sphereClusterKernelScalar(const ClusterBounds& bounds, int first, int count, float x, float y, float z, float r2, std::vector<uint32_t>& hits) {
+    for (int i = first; i < first + count; i++) {
+        float dx = fmaxf(fmaxf(bounds.minX[i] - x, x - bounds.maxX[i]), 0.0f);
+        float dy = fmaxf(fmaxf(bounds.minY[i] - y, y - bounds.maxY[i]), 0.0f);
+        float dz = fmaxf(fmaxf(bounds.minZ[i] - z, z - bounds.maxZ[i]), 0.0f);
+        if (dx * dx + dy * dy + dz * dz <= r2) {
+            hits.push_back(i);
+        }
+    }
+}
+
+#ifdef LIGHT_CLUSTERS_SSE
+void sphereClusterKernelSSE(const ClusterBounds& bounds, int first, int count, float x, float y, float z, float r2, std::vector<uint32_t>& hits) {
+    __m128 cx = _mm_set1_ps(x), cy = _mm_set1_ps(y), cz = _mm_set1_ps(z);
+    __m128 radius2 = _mm_set1_ps(r2);
+    __m128 zero = _mm_setzero_ps();
+    int i = first;
+    int end = first + count;
+    for (; i + 4 <= end; i += 4) {
+        __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&bounds.minX[i]), cx), _mm_sub_ps(cx, _mm_loadu_ps(&bounds.maxX[i]))), zero);
+        __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&bounds.minY[i]), cy), _mm_sub_ps(cy, _mm_loadu_ps(&bounds.maxY[i]))), zero);
+        __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&bounds.minZ[i]), cz), _mm_sub_ps(cz, _mm_loadu_ps(&bounds.maxZ[i]))), zero);
+        __m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        int mask = _mm_movemask_ps(_mm_cmple_ps(distance2, radius2));
+        // Most groups of four miss completely, so the mask is checked before looking at its bits
+        while (mask) {
+            int lane = 0;
+            while (!(mask & (1 << lane))) {
+                lane++;
+            }
+            hits.push_back(i + lane);
+            mask &= mask - 1;
+        }
+    }
+    sphereClusterKernelScalar(bounds, i, end - i, x, y, z, r2, hits);
+}
+#endif
+
+// Runs the kernel picked by lightClusterKernel
+void sphereClusterKernel(const ClusterBounds& bounds, int first, int count, float x, float y, float z, float r2, std::vector<uint32_t>& hits) {
+#ifdef LIGHT_CLUSTERS_SSE
+    if (lightClusterKernel == LIGHT_CLUSTERS_SIMD) {
+        sphereClusterKernelSSE(bounds, first, count, x, y, z, r2, hits);
+        return;
+    }
+#endif
+    sphereClusterKernelScalar(bounds, first, count, x, y, z, r2, hits);
+}
+
+// Counts from the last build
+struct LightClusterStats
+{
+    size_t lightsVisible;       // Lights that touched at least one cluster
+    size_t references;          // Entries in the index list, a light is counted once for every cluster it touches
+    size_t maxLightsPerCluster;
+};
+
+/*
+Sorts the point lights into the clusters they reach so a fragment only has to shade the lights of the cluster it is in.
+Everything is on the CPU and doesn't need a GL context. After build():
+- grid() has two numbers per cluster, where its lights start in indices() and how many there are
+- indices() has the light indices of every cluster one after another, lowest index first within a cluster
+Cluster (x, y, z) is at x + CLUSTER_COUNT_X * (y + CLUSTER_COUNT_Y * z), tile (0, 0) is the bottom left of the screen.
+*/
+class LightClusters
+{
+public:
+    LightClusterStats stats = { 0, 0, 0 };
+
+    LightClusters() : gridData(CLUSTER_COUNT * 2, 0), counts(CLUSTER_COUNT, 0) {}
+
+    // Sets up the clusters for a perspective projection, the bounds are only worked out again if it has changed
+    void setProjection(float fovY, float aspect, float nearPlane, float farPlane) {
+        if (fovY == projection[0] && aspect == projection[1] && nearPlane == projection[2] && farPlane == projection[3]) {
+            return;
+        }
+        projection[0] = fovY;
+        projection[1] = aspect;
+        projection[2] = nearPlane;
+        projection[3] = farPlane;
+        this->nearPlane = nearPlane;
+        float depthRatio = logf(farPlane / nearPlane);
+        sliceScale = CLUSTER_COUNT_Z / depthRatio;
+        sliceBias = CLUSTER_COUNT_Z * logf(nearPlane) / depthRatio;
+        buildBounds(tanf(fovY * 0.5f) * aspect, tanf(fovY * 0.5f), nearPlane, farPlane);
+    }
+
+    /*
+    Bins count lights given by their world space positions and how far they reach (pointLightRadius), view is the camera's
+    view matrix. Lights with a radius of 0 are skipped, which is how the registry's empty slots stay out.
+    */
+    void build(const glm::mat4& view, const glm::vec3* positions, const float* radii, int count) {
+        clusterHits.clear();
+        pairClusters.clear();
+        pairLights.clear();
+        stats = { 0, 0, 0 };
+        for (int light = 0; light < count; light++) {
+            float radius = radii[light];
+            if (radius <= 0.0f) {
+                continue;
+            }
+            glm::vec3 centre = glm::vec3(view * glm::vec4(positions[light], 1.0f));
+            // View space looks down -z, so the light covers depths from -z - radius to -z + radius
+            int firstSlice = sliceAt(-centre.z - radius);
+            int lastSlice = sliceAt(-centre.z + radius);
+            if (-centre.z + radius < nearPlane || firstSlice >= CLUSTER_COUNT_Z) {
+                continue;
+            }
+            lastSlice = lastSlice < CLUSTER_COUNT_Z - 1 ? lastSlice : CLUSTER_COUNT_Z - 1;
+            size_t before = clusterHits.size();
+            for (int slice = firstSlice; slice <= lastSlice; slice++) {
+                sphereClusterKernel(bounds, slice * CLUSTERS_PER_SLICE, CLUSTERS_PER_SLICE, centre.x, centre.y, centre.z, radius * radius, clusterHits);
+            }
+            for (size_t i = before; i < clusterHits.size(); i++) {
+                pairClusters.push_back(clusterHits[i]);
+                pairLights.push_back(light);
+            }
+            if (clusterHits.size() > before) {
+                stats.lightsVisible++;
+            }
+        }
+        sortPairs();
+    }
+
+    const std::vector<uint32_t>& grid() const {
+        return gridData;
+    }
+
+    const std::vector<uint32_t>& indices() const {
+        return indexData;
+    }
+
+    // A fragment's slice is log(depth) * sliceScale - sliceBias, both go in the FrameData block
+    float zScale() const {
+        return sliceScale;
+    }
+
+    float zBias() const {
+        return sliceBias;
+    }
+
+    const ClusterBounds& clusterBounds() const {
+        return bounds;
+    }
+
+private:
+    ClusterBounds bounds;
+    float projection[4] = { 0, 0, 0, 0 };
+    float nearPlane = 0.1f;
+    float sliceScale = 0.0f;
+    float sliceBias = 0.0f;
+    std::vector<uint32_t> gridData;
+    std::vector<uint32_t> indexData;
+    std::vector<uint32_t> counts;
+    // Every (cluster, light) pair found, sorted into the grid by counting how many each cluster has
+    std::vector<uint32_t> clusterHits;
+    std::vector<uint32_t> pairClusters;
+    std::vector<uint32_t> pairLights;
+
+    // The slice a view depth is in, depths in front of the near plane are in slice 0
+    int sliceAt(float depth) const {
+        if (depth <= nearPlane) {
+            return 0;
+        }
+        return (int)floorf(logf(depth) * sliceScale - sliceBias);
+    }
+
+    // A tile's corners on the near and far side of its slice, in view space, with tanX and tanY the frustum's half widths
+    void buildBounds(float tanX, float tanY, float nearPlane, float farPlane) {
+        for (std::vector<float>* side : { &bounds.minX, &bounds.minY, &bounds.minZ, &bounds.maxX, &bounds.maxY, &bounds.maxZ }) {
+            side->assign(CLUSTER_COUNT, 0.0f);
+        }
+        for (int z = 0; z < CLUSTER_COUNT_Z; z++) {
+            float depths[2] = {
+                nearPlane * powf(farPlane / nearPlane, (float)z / CLUSTER_COUNT_Z),
+                nearPlane * powf(farPlane / nearPlane, (float)(z + 1) / CLUSTER_COUNT_Z)
+            };
+            for (int y = 0; y < CLUSTER_COUNT_Y; y++) {
+                float ndcY[2] = { -1.0f + 2.0f * y / CLUSTER_COUNT_Y, -1.0f + 2.0f * (y + 1) / CLUSTER_COUNT_Y };
+                for (int x = 0; x < CLUSTER_COUNT_X; x++) {
+                    float ndcX[2] = { -1.0f + 2.0f * x / CLUSTER_COUNT_X, -1.0f + 2.0f * (x + 1) / CLUSTER_COUNT_X };
+                    glm::vec3 low(INFINITY), high(-INFINITY);
+                    for (float depth : depths) {
+                        for (float nx : ndcX) {
+                            for (float ny : ndcY) {
+                                glm::vec3 corner(nx * tanX * depth, ny * tanY * depth, -depth);
+                                low = glm::min(low, corner);
+                                high = glm::max(high, corner);
+                            }
+                        }
+                    }
+                    int i = x + CLUSTER_COUNT_X * (y + CLUSTER_COUNT_Y * z);
+                    bounds.minX[i] = low.x;
+                    bounds.minY[i] = low.y;
+                    bounds.minZ[i] = low.z;
+                    bounds.maxX[i] = high.x;
+                    bounds.maxY[i] = high.y;
+                    bounds.maxZ[i] = high.z;
+                }
+            }
+        }
+    }
+
+    void sortPairs() {
+        std::fill(counts.begin(), counts.end(), 0);
+        for (uint32_t cluster : pairClusters) {
+            counts[cluster]++;
+        }
+        uint32_t offset = 0;
+        for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+            gridData[cluster * 2] = offset;
+            gridData[cluster * 2 + 1] = counts[cluster];
+            offset += counts[cluster];
+            stats.maxLightsPerCluster = counts[cluster] > stats.maxLightsPerCluster ? counts[cluster] : stats.maxLightsPerCluster;
+            // Used as the next free place in the cluster's list while filling it
+            counts[cluster] = gridData[cluster * 2];
+        }
+        // The pairs were found light by light, so each cluster's lights go in lowest first
+        indexData.resize(pairClusters.size());
+        for (size_t i = 0; i < pairClusters.size(); i++) {
+            indexData[counts[pairClusters[i]]++] = pairLights[i];
+        }
+        stats.references = indexData.size();
+    }
+};
+
+/*
+Times build() with lightCount lights scattered through a 160 x 24 x 160 block area around a camera looking down it, with
+the lights the game places. Prints the SIMD and scalar kernels so the difference can be seen.
+*/
+inline void benchmarkLightClusters(int lightCount, int iterations = 100) {
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> across(-80.0f, 80.0f);
+    std::uniform_real_distribution<float> up(0.0f, 24.0f);
+    std::vector<glm::vec3> positions(lightCount);
+    std::vector<float> radii(lightCount);
+    PointLightData light;
+    light.ambient = glm::vec3(0.3f, 0.24f, 0.14f);
+    light.diffuse = glm::vec3(0.7f, 0.5f, 0.3f);
+    light.specular = glm::vec3(1.0f, 0.9f, 0.8f);
+    light.constant = 1.0f;
+    light.linear = 0.18f;
+    light.quadratic = 0.12f;
+    for (int i = 0; i < lightCount; i++) {
+        positions[i] = glm::vec3(across(random), up(random), across(random));
+        radii[i] = pointLightRadius(light);
+    }
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 12.0f, 80.0f), glm::vec3(0.0f, 8.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    LightClusterKernel kernel = lightClusterKernel;
+    const char* names[2] = { "scalar", "simd" };
+    for (int mode = LIGHT_CLUSTERS_SCALAR; mode <= LIGHT_CLUSTERS_SIMD; mode++) {
+        lightClusterKernel = (LightClusterKernel)mode;
+        LightClusters clusters;
+        clusters.setProjection(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 500.0f);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            clusters.build(view, positions.data(), radii.data(), lightCount);
+        }
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+        printf("Light clusters (%s): %d lights, %zu visible, %zu references, %zu most in a cluster, %.3f ms per build\n",
+               names[mode], lightCount, clusters.stats.lightsVisible, clusters.stats.references, clusters.stats.maxLightsPerCluster, milliseconds);
+    }
+    lightClusterKernel = kernel;
+}
+
+#endif
@@ -0,0 +1,234 @@
+#ifndef LIGHTREGISTRY_H
+#define LIGHTREGISTRY_H
+
+#include <algorithm>
+#include <vector>
+#include "frameUniforms.h"
+
+// Counts kept by the registry, the frame ones are from the last flush so they show what a frame cost
+struct LightRegistryStats
+{
+    size_t lightsUploadedLastFlush;  // Lights packed and sent by the last flush, 0 on frames where nothing changed
+    size_t writesLastFlush;          // Buffer writes made by the last flush, one per dirty range
+    size_t lightsUploaded;           // Every light ever sent
+    size_t writes;
+    size_t grows;                    // Times the registry ran out of slots and doubled
+};
+
+/*
+The point lights, kept as one array per field so the clustering only touches the positions and radii, and which of them
+the GPU hasn't seen yet. Each light sits in a slot that is its index in the LightData storage buffer. Removing a light
+frees its slot for the next light added, the slot gets a radius of 0 so it is never put in a cluster and the GPU never
+reads what is left there.
+
+Adding or changing a light marks just its slot dirty, and flush packs and sends only the dirty ranges, each as one write
+at the slot's offset in the buffer. Lights are placed once and then left alone for thousands of frames, so nearly every
+flush has nothing to do. When every slot is taken the registry doubles, the buffer has to be made again at storageSize()
+and every light is sent again.
+*/
+class LightRegistry
+{
+public:
+    LightRegistryStats stats = { 0, 0, 0, 0, 0 };
+
+    LightRegistry(int initialCapacity = 64) : capacity(initialCapacity > 0 ? initialCapacity : 1) {}
+
+    // Returns the new light's slot
+    int add(const PointLightData& light) {
+        int slot;
+        if (!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else {
+            if (slotCount() == capacity) {
+                grow();
+            }
+            slot = slotCount();
+            resizeSlots(slot + 1);
+        }
+        store(slot, light);
+        active[slot] = 1;
+        activeCount++;
+        markDirty(slot, slot + 1);
+        return slot;
+    }
+
+    // Frees the slot for the next light added, nothing is sent as nothing will read it
+    void remove(int slot) {
+        if (slot < 0 || slot >= slotCount() || !active[slot]) {
+            return;
+        }
+        active[slot] = 0;
+        radii[slot] = 0.0f;
+        activeCount--;
+        freeSlots.push_back(slot);
+    }
+
+    void set(int slot, const PointLightData& light) {
+        store(slot, light);
+        markDirty(slot, slot + 1);
+    }
+
+    PointLightData get(int slot) const {
+        PointLightData light;
+        light.position = positions[slot];
+        light.constant = attenuations[slot].x;
+        light.linear = attenuations[slot].y;
+        light.quadratic = attenuations[slot].z;
+        light.ambient = ambients[slot];
+        light.diffuse = diffuses[slot];
+        light.specular = speculars[slot];
+        return light;
+    }
+
+    bool isActive(int slot) const {
+        return slot >= 0 && slot < slotCount() && active[slot];
+    }
+
+    // Returns the slot of the closest light within maxDistance of position, or -1 if there isn't one
+    int nearest(glm::vec3 position, float maxDistance) const {
+        int closest = -1;
+        float closestDistance2 = maxDistance * maxDistance;
+        for (int slot = 0; slot < slotCount(); slot++) {
+            glm::vec3 offset = positions[slot] - position;
+            float distance2 = glm::dot(offset, offset);
+            if (active[slot] && distance2 <= closestDistance2) {
+                closest = slot;
+                closestDistance2 = distance2;
+            }
+        }
+        return closest;
+    }
+
+    // Every slot that has been used, lights that were removed included, for looping over with positions() and radii()
+    int slotCount() const {
+        return (int)positions.size();
+    }
+
+    int count() const {
+        return activeCount;
+    }
+
+    const glm::vec3* positionData() const {
+        return positions.data();
+    }
+
+    // How far each light reaches (pointLightRadius), 0 for removed lights
+    const float* radiusData() const {
+        return radii.data();
+    }
+
+    // Bytes the storage buffer needs to hold every slot the registry has room for
+    size_t storageSize() const {
+        return (size_t)capacity * POINT_LIGHT_STRIDE;
+    }
+
+    bool isDirty() const {
+        return !dirty.empty();
+    }
+
+    /*
+    Packs each dirty range and calls write(bytes, offset) with it, offset being where the range starts in the LightData
+    buffer. Does nothing, and costs nothing, when no light has changed.
+    */
+    template <typename Write>
+    void flush(Write write) {
+        stats.lightsUploadedLastFlush = 0;
+        stats.writesLastFlush = 0;
+        if (dirty.empty()) {
+            return;
+        }
+        mergeDirtyRanges();
+        for (const Range& range : dirty) {
+            Std140Writer writer(packed);
+            for (int slot = range.begin; slot < range.end; slot++) {
+                writePointLight(writer, get(slot));
+            }
+            write(packed, (size_t)range.begin * POINT_LIGHT_STRIDE);
+            stats.lightsUploadedLastFlush += range.end - range.begin;
+            stats.writesLastFlush++;
+        }
+        stats.lightsUploaded += stats.lightsUploadedLastFlush;
+        stats.writes += stats.writesLastFlush;
+        dirty.clear();
+    }
+
+private:
+    // Slots from begin up to but not including end
+    struct Range {
+        int begin;
+        int end;
+    };
+
+    int capacity;
+    int activeCount = 0;
+    std::vector<glm::vec3> positions;
+    std::vector<float> radii;
+    std::vector<glm::vec3> attenuations;  // constant, linear and quadratic
+    std::vector<glm::vec3> ambients;
+    std::vector<glm::vec3> diffuses;
+    std::vector<glm::vec3> speculars;
+    std::vector<uint8_t> active;
+    std::vector<int> freeSlots;
+    std::vector<Range> dirty;
+    std::vector<uint8_t> packed;
+
+    void store(int slot, const PointLightData& light) {
+        positions[slot] = light.position;
+        radii[slot] = pointLightRadius(light);
+        attenuations[slot] = glm::vec3(light.constant, light.linear, light.quadratic);
+        ambients[slot] = light.ambient;
+        diffuses[slot] = light.diffuse;
+        speculars[slot] = light.specular;
+    }
+
+    void resizeSlots(int count) {
+        positions.resize(count);
+        radii.resize(count);
+        attenuations.resize(count);
+        ambients.resize(count);
+        diffuses.resize(count);
+        speculars.resize(count);
+        active.resize(count);
+    }
+
+    // The buffer gets made again at the new size, so everything in it has to be sent again
+    void grow() {
+        capacity *= 2;
+        stats.grows++;
+        dirty.clear();
+        if (slotCount() > 0) {
+            markDirty(0, slotCount());
+        }
+    }
+
+    void markDirty(int begin, int end) {
+        // Lights are nearly always added or changed one after another, so most marks just grow the last range
+        if (!dirty.empty() && begin <= dirty.back().end && end >= dirty.back().begin) {
+            dirty.back().begin = std::min(dirty.back().begin, begin);
+            dirty.back().end = std::max(dirty.back().end, end);
+            return;
+        }
+        dirty.push_back({ begin, end });
+    }
+
+    // Sorts the ranges and joins any that overlap or touch, so no light is sent twice and touching ranges are one write
+    void mergeDirtyRanges() {
+        std::sort(dirty.begin(), dirty.end(), [](const Range& a, const Range& b) {
+            return a.begin < b.begin;
+        });
+        size_t merged = 0;
+        for (size_t i = 1; i < dirty.size(); i++) {
+            if (dirty[i].begin <= dirty[merged].end) {
+                dirty[merged].end = std::max(dirty[merged].end, dirty[i].end);
+            }
+            else {
+                dirty[++merged] = dirty[i];
+            }
+        }
+        dirty.resize(merged + 1);
+    }
+};
+
+#endif
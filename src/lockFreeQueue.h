@@ -0,0 +1,63 @@
+#ifndef LOCKFREEQUEUE_H
+#define LOCKFREEQUEUE_H
+
+#include <atomic>
+#include <utility>
+
+/*
+An unbounded queue any number of threads can push to without taking a lock, and that one thread takes items out of.
+Pushing swaps the new node in as the head with a single atomic exchange, so a worker handing back a result never waits
+on the thread reading them. Items come out in the order they were pushed.
+T has to be default constructible, the node at the tail always holds a spent item.
+*/
+template <typename T>
+class LockFreeQueue
+{
+public:
+    LockFreeQueue() {
+        Node* stub = new Node();
+        head.store(stub, std::memory_order_relaxed);
+        tail = stub;
+    }
+
+    ~LockFreeQueue() {
+        T item;
+        while (pop(item)) {}
+        delete tail;
+    }
+
+    LockFreeQueue(const LockFreeQueue&) = delete;
+    LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+    // Can be called from any thread
+    void push(T item) {
+        Node* node = new Node();
+        node->item = std::move(item);
+        Node* previous = head.exchange(node, std::memory_order_acq_rel);
+        // Until this store the node can't be reached from the tail, pop just sees the queue as empty for that moment
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    // Only one thread may pop, returns false if there is nothing to take
+    bool pop(T& item) {
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (!next) {
+            return false;
+        }
+        item = std::move(next->item);
+        delete tail;
+        tail = next;
+        return true;
+    }
+
+private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        T item;
+    };
+
+    std::atomic<Node*> head;
+    Node* tail;
+};
+
+#endif
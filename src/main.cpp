@@ -12,6 +12,12 @@
 #include "camera.h"
 #include "perlin.h"
 #include "timeCycle.h"
+#include "chunkRenderer.h"
+#include "chunkStreamer.h"
+#include "glUploadBackends.h"
+#include "heightmapIO.h"
+#include "lightRegistry.h"
+#include "lightClusters.h"
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
@@ -20,51 +26,73 @@ void processInput(GLFWwindow *window);
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 unsigned int loadTexture(char const * path);
+unsigned int loadTextureArray(const char* const* paths, int count);
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
-void createPointLight(int index, Shader& lightingShader);
-void renderScene(GLFWwindow* window, Shader shader);
-void configureMatricesAndShaders();
-void initializeBuffers(unsigned int* VAO, unsigned int* instanceVBO, unsigned int* VBO, unsigned int* EBO);
+bool pickBlock(RaycastHit& hit);
+void editBlock(int x, int y, int z, BlockID block);
+PointLightData createPointLight(glm::vec3 position);
+void renderScene(GLFWwindow* window, Shader& shader);
+void configureMatricesAndShaders(Shader& shader);
+void initializeBuffers(unsigned int* VAO, unsigned int* VBO, unsigned int* EBO);
+void bindInstanceBuffer();
 void updateInstanceData();
 
 Shader lightingShader;
+Shader chunkShader;
 Shader simpleDepthShader;
 
-unsigned int VBO, cubeVAO, instanceVBO, EBO;
+unsigned int VBO, cubeVAO, EBO;
+
+// The instanced cubes are written into a persistently mapped ring so updating them is a memcpy instead of a reallocation
+std::unique_ptr<UploadBackend> instanceUploadBackend;
+std::unique_ptr<UploadRing> instanceRing;
+int instanceBufferGeneration = 0;
 
 int seed;
 
-void generateWorldFromHeightmap(const char* heightmapPath, std::vector<cube*>& cubes, int MAX_HEIGHT, unsigned int* vao) {
-    createPerlinNoise(64, 256, 256, seed);
-    int width, height, nrChannels;
-    unsigned char* heightmapData = stbi_load(heightmapPath, &width, &height, &nrChannels, 1); // Load as grayscale
-    if (!heightmapData) {
-        std::cout << "Failed to load heightmap" << std::endl;
+// Workers used for generating the world, 0 uses every core the machine has
+ThreadPool generationPool(0);
+
+// Set (H key) to save each generated heightmap to perlin.bmp and perlin.hmap, the world is built straight from memory either way
+bool exportHeightmap = false;
+
+// Set while an export is writing perlin.bmp and perlin.hmap, so two exports never write the same files at once
+std::atomic<bool> exportRunning{false};
+
+/*
+Saves the 256 x 256 blocks from (0, 0) of the current seed's terrain in the background, as an 8 bit bitmap to look at and
+as a float .hmap that loads back into exactly the same terrain. The world itself has no edges any more.
+Does nothing if the last export hasn't finished yet.
+*/
+void exportWorldHeightmap() {
+    if (exportRunning.exchange(true)) {
+        printf("Still saving the last heightmap, this world's heightmap was not saved\n");
         return;
     }
-    std::vector<cube*> temp;
-    for (int z = 0; z < height; ++z) {
-        for (int x = 0; x < width; ++x) {
-            unsigned char pixelValue = heightmapData[z * width + x];
-            float normalizedHeight = pixelValue / 255.0f; // Normalize [0, 1]
-            int cubeHeight = static_cast<int>(normalizedHeight * MAX_HEIGHT);
-            
-            // Create cubes stacked vertically
-            for (int y = 0; y < cubeHeight; ++y) {
-                if(y < 4) {
-                    temp.push_back(new cube(glm::vec3(x, y, z), STONE, &lightingShader, &cubeVAO, &VBO, cubes));
-                }
-                else {
-                    temp.push_back(new cube(glm::vec3(x, y, z), DIRT, &lightingShader, &cubeVAO, &VBO, cubes));
-                }
-                
-            }
+    int exportSeed = seed;
+    generationPool.submit([exportSeed]() {
+        BmpSink bitmap("perlin.bmp", BMP_GRAYSCALE8);
+        HeightFileSink heights("perlin.hmap", HEIGHT_FLOAT32);
+        for (HeightmapSink* sink : { (HeightmapSink*)&bitmap, (HeightmapSink*)&heights }) {
+            streamPerlinNoise(*sink, 64, TERRAIN_NOISE_OFFSET, TERRAIN_NOISE_OFFSET, 256, 256, exportSeed);
         }
-    }
-    cubes = temp;
-    updateInstanceData();
+        printf("Saved perlin.bmp and perlin.hmap\n");
+        exportRunning = false;
+    });
+}
 
-    stbi_image_free(heightmapData);
+// Loads and unloads chunks around the camera in the background, the world is generated a chunk at a time as it is needed
+ChunkStreamer chunkStreamer(generationPool, world, 8);
+
+/*
+Starts building a new world from the seed without waiting for it. The first world streams in closest chunks first, after that
+the current world stays on screen while the new one is built and is swapped out once the new one is ready.
+*/
+void generateWorld(int maxHeight) {
+    chunkStreamer.regenerate(createTerrainSettings(seed, maxHeight));
+    if (exportHeightmap) {
+        exportWorldHeightmap();
+    }
 }
 
 // settings
@@ -81,13 +109,37 @@ float deltaTime = 0.0f;	// time between current frame and last frame
 float lastFrame = 0.0f;
 
 bool bilin = true;
+// Draws the world as one face culled mesh per chunk, turning this off (M key) goes back to drawing a whole cube per block
+bool useChunkMeshes = true;
 bool gamma = false;
 
 glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
 
+// Left click breaks the block being looked at and middle click places this one against it, up to BLOCK_REACH blocks away
+const float BLOCK_REACH = 8.0f;
+BlockID placeBlockType = BLOCK_DIRT;
+
+
+// Only the lights that have changed since the last frame are sent to the GPU
+LightRegistry pointLights;
 
-glm::vec3 pointLightPositions[100];
-int pointLightCount = 0;
+// The per-frame state is packed into a uniform buffer and sent with one write, the lights go in a storage buffer that grows
+UniformBuffer frameUniformBuffer;
+StorageBuffer lightStorageBuffer;
+FrameData frameData;
+std::vector<uint8_t> uniformBytes;
+
+// The lights are sorted into clusters of the view frustum every frame, so each fragment only shades the lights near it
+LightClusters lightClusters;
+TextureBuffer clusterGridBuffer;
+TextureBuffer clusterIndexBuffer;
+// Texture units the cluster lists are read from, unit 0 has the block textures
+#define CLUSTER_GRID_UNIT 1
+#define CLUSTER_INDEX_UNIT 2
+
+// Size of the framebuffer in pixels, which can be more than the window size on high DPI screens
+int framebufferWidth = SCR_WIDTH;
+int framebufferHeight = SCR_HEIGHT;
 
 int width = 20;
 int height = 2;
@@ -117,6 +169,7 @@ int main()
         return -1;
     }
     glfwMakeContextCurrent(window);
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetKeyCallback(window, key_callback);
@@ -131,8 +184,16 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
-    lightingShader.createShader("lighting.vs", "lighting.fs");
+    lightingShader.createShader("lighting.vs", "lighting.fs", nullptr, clusterShaderDefines());
+    chunkShader.createShader("shaders/chunk.vs", "lighting.fs", nullptr, clusterShaderDefines());
     simpleDepthShader.createShader("shaders/depth.vs", "shaders/depth.fs");
+    for (Shader* shader : { &lightingShader, &chunkShader }) {
+        shader->bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+    }
+    frameUniformBuffer.create(FRAME_DATA_SIZE, FRAME_DATA_BINDING);
+    lightStorageBuffer.create(pointLights.storageSize(), LIGHT_DATA_BINDING);
+    clusterGridBuffer.create(GL_RG32UI, CLUSTER_COUNT * 2 * sizeof(uint32_t));
+    clusterIndexBuffer.create(GL_R32UI, CLUSTER_COUNT * sizeof(uint32_t));
 
     const char* version = (const char*)glGetString(GL_VERSION);
     std::cout << "OpenGL Version: " << version << std::endl;
@@ -142,23 +203,29 @@ int main()
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
     
-    initializeBuffers(&cubeVAO, &instanceVBO, &VBO, &EBO);
+    instanceUploadBackend = createUploadBackend();
+    // 1MB sections to start with, a multiple of sizeof(BlockInstance) so every section starts on a whole instance
+    instanceRing = std::make_unique<UploadRing>(*instanceUploadBackend, 1 << 20);
+    initializeBuffers(&cubeVAO, &VBO, &EBO);
 
     unsigned int floorTexture = loadTexture("wood.png");
     unsigned int floorTextureGammaCorrected = loadTexture("wood.png");
 
-    lightingShader.use(); 
-    lightingShader.setInt("material.diffuse", 0);
-    lightingShader.setFloat("light.constant",  1.0f);
-    lightingShader.setFloat("light.linear",    0.09f);
-    lightingShader.setFloat("light.quadratic", 0.032f);	
+    // Both world shaders share the same fragment shader so they need the same settings
+    for (Shader* shader : { &lightingShader, &chunkShader }) {
+        shader->use();
+        shader->setInt("material.diffuse", 0);
+        shader->setInt("clusterGrid", CLUSTER_GRID_UNIT);
+        shader->setInt("clusterLightIndices", CLUSTER_INDEX_UNIT);
+        shader->setFloat("light.constant",  1.0f);
+        shader->setFloat("light.linear",    0.09f);
+        shader->setFloat("light.quadratic", 0.032f);
+    }
     seed = time(NULL);
-    glGenTextures(3, textures); // Generate texture IDs for 3 textures
-    textures[DIRT] = loadTexture("dirt.png");
-    textures[STONE] = loadTexture("stone.png");
-    textures[GRASS] = loadTexture("grass.png");
-    generateWorldFromHeightmap("perlin.bmp", cubes, 18, &cubeVAO);
-    printf("Amount of blocks in the world: %d\n", cubes.size());
+    // In TextureID order
+    const char* blockTexturePaths[] = { "dirt.png", "grass.png", "stone.png" };
+    blockTextureArray = loadTextureArray(blockTexturePaths, 3);
+    generateWorld(18);
     
 
 
@@ -204,9 +271,13 @@ int main()
         // 2. then render scene as normal with shadow mapping (using depth map)
         glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
         */
-        camera.updateCameraPosition(deltaTime);
-        configureMatricesAndShaders();
-        renderScene(window, lightingShader);
+        chunkStreamer.update(camera.Position);
+        remeshDirtyChunks(world);
+        // The camera waits for the ground under it to be loaded instead of falling through
+        camera.updatePhysics(world, chunkStreamer.isLoaded(camera.Position) ? deltaTime : 0.0f);
+        Shader& worldShader = useChunkMeshes ? chunkShader : lightingShader;
+        configureMatricesAndShaders(worldShader);
+        renderScene(window, worldShader);
 
         glfwSwapBuffers(window);
         glfwPollEvents();   
@@ -216,6 +287,13 @@ int main()
     // ------------------------------------------------------------------------
     glDeleteVertexArrays(1, &cubeVAO);
     glDeleteBuffers(1, &VBO);
+    // The globals below would otherwise be freed after glfwTerminate, when there is no context left to delete them with
+    instanceRing.reset();
+    instanceUploadBackend.reset();
+    frameUniformBuffer.destroy();
+    lightStorageBuffer.destroy();
+    clusterGridBuffer.destroy();
+    clusterIndexBuffer.destroy();
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
@@ -231,20 +309,16 @@ void processInput(GLFWwindow *window)
         glfwSetWindowShouldClose(window, true);
 
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        camera.ProcessKeyboard(FORWARD, deltaTime);
+        camera.ProcessKeyboard(FORWARD);
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        camera.ProcessKeyboard(BACKWARD, deltaTime);
+        camera.ProcessKeyboard(BACKWARD);
     if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        camera.ProcessKeyboard(LEFT, deltaTime);
+        camera.ProcessKeyboard(LEFT);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        camera.ProcessKeyboard(RIGHT, deltaTime);
+        camera.ProcessKeyboard(RIGHT);
     if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) {
         camera.Jump();
     }
-    if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS) {
-        seed = time(NULL);
-        generateWorldFromHeightmap("perlin.bmp", cubes, 32, &cubeVAO);
-    }
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -254,6 +328,8 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     // make sure the viewport matches the new window dimensions; note that width and 
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
+    framebufferWidth = width;
+    framebufferHeight = height;
 }
 
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
@@ -290,6 +366,56 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
             camera.Zoom /= 1.2f;
         }
     }
+    if (key == GLFW_KEY_M && action == GLFW_RELEASE) {
+        useChunkMeshes = !useChunkMeshes;
+        printf(useChunkMeshes ? "Drawing chunk meshes\n" : "Drawing instanced cubes\n");
+    }
+    if (key == GLFW_KEY_N && action == GLFW_RELEASE) {
+        chunkMeshMode = chunkMeshMode == MESH_GREEDY ? MESH_CULLED : MESH_GREEDY;
+        // The loaded chunks are remeshed a few a frame, chunks the streamer was already making are marked as they arrive
+        markStaleMeshes();
+        printf("%s meshing: remeshing %zu chunks\n", chunkMeshMode == MESH_GREEDY ? "Greedy" : "Culled", staleChunks.size());
+    }
+    // Handled here rather than in processInput so holding the key down only starts one new world
+    if (key == GLFW_KEY_G && action == GLFW_RELEASE) {
+        int newSeed = (int)time(NULL);
+        // Pressing it any number of times in the same second still gives a different world each time
+        seed = newSeed > seed ? newSeed : seed + 1;
+        generateWorld(32);
+    }
+    if (key == GLFW_KEY_L && action == GLFW_RELEASE) {
+        // Loads the heightmap the H key saves, the noise of the current seed carries on around it
+        TerrainSettings settings = createTerrainSettings(seed, 32);
+        if (exportRunning) {
+            printf("perlin.hmap is still being saved, try again in a moment\n");
+        }
+        else if (loadTerrainHeightmap("perlin.hmap", settings)) {
+            printf("Building the world from perlin.hmap (%d x %d)\n", settings.heightmap->width, settings.heightmap->height);
+            chunkStreamer.regenerate(settings);
+        }
+    }
+    if (key == GLFW_KEY_K && action == GLFW_RELEASE) {
+        printf("Loaded chunks: %zu (%zu loaded, %zu evicted, %zu pending)\n", world.chunkCount(), chunkStreamer.chunksLoaded,
+               chunkStreamer.chunksEvicted, chunkStreamer.pendingCount());
+        printf("Point lights: %d in %d slots (%zu uploaded last frame in %zu writes, %zu uploaded in total, grown %zu times)\n",
+               pointLights.count(), pointLights.slotCount(), pointLights.stats.lightsUploadedLastFlush, pointLights.stats.writesLastFlush,
+               pointLights.stats.lightsUploaded, pointLights.stats.grows);
+        if (instanceStats.totalBlocks > 0) {
+            printf("Block instances: %zu of %zu blocks drawn (%.1f%% skipped as buried)\n", instanceStats.emittedBlocks, instanceStats.totalBlocks,
+                   100.0 * (instanceStats.totalBlocks - instanceStats.emittedBlocks) / instanceStats.totalBlocks);
+        }
+        benchmarkMesher(world);
+        benchmarkLightClusters(100);
+        benchmarkLightClusters(1000);
+        benchmarkLightClusters(5000, 10);
+    }
+    if (key == GLFW_KEY_H && action == GLFW_RELEASE) {
+        exportHeightmap = !exportHeightmap;
+        printf(exportHeightmap ? "Saving heightmaps of every world\n" : "Not saving heightmaps\n");
+        if (exportHeightmap) {
+            exportWorldHeightmap();
+        }
+    }
     if (key == GLFW_KEY_B && action == GLFW_RELEASE) {
             if(bilin) {
                 bilin = false;
@@ -347,67 +473,177 @@ unsigned int loadTexture(char const * path)
     return textureID;
 }
 
+/*
+Loads every image into one layer of a GL_TEXTURE_2D_ARRAY, they all need to be the same size as the first one.
+Greedy meshed faces stretch over several blocks, so the layers repeat rather than clamp.
+*/
+unsigned int loadTextureArray(const char* const* paths, int count)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+
+    int layerWidth = 0, layerHeight = 0;
+    for (int i = 0; i < count; i++)
+    {
+        int width, height, nrComponents;
+        // Every layer is loaded as RGBA so they all share one format
+        unsigned char *data = stbi_load(paths[i], &width, &height, &nrComponents, 4);
+        if (!data)
+        {
+            std::cout << "Texture failed to load at path: " << paths[i] << std::endl;
+            continue;
+        }
+        if (layerWidth == 0)
+        {
+            layerWidth = width;
+            layerHeight = height;
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, layerWidth, layerHeight, count, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        }
+        if (width != layerWidth || height != layerHeight)
+        {
+            std::cout << "Texture " << paths[i] << " is not the same size as the other layers" << std::endl;
+        }
+        else
+        {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        }
+        stbi_image_free(data);
+    }
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    return textureID;
+}
+
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 {
     if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_RELEASE) {
-        if (pointLightCount < 100) { // Ensure we don't exceed the array bounds
+        // Shift right click takes away the closest light in reach, its slot is used again by the next light placed
+        if (mods & GLFW_MOD_SHIFT) {
+            pointLights.remove(pointLights.nearest(camera.Position, BLOCK_REACH));
+        }
+        else {
             // Add a new light position based on the camera position
-            pointLightPositions[pointLightCount] = glm::vec3(camera.Position.x, camera.Position.y, camera.Position.z);
-            pointLightCount++; // Increment the count
+            pointLights.add(createPointLight(camera.Position));
+        }
+    }
+    // The cursor is hidden, so blocks are picked along the middle of the screen where the camera is looking
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_RELEASE) {
+        RaycastHit hit;
+        if (pickBlock(hit)) {
+            editBlock(hit.block[0], hit.block[1], hit.block[2], BLOCK_AIR);
         }
-        if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_RELEASE) {
-            double mouseX, mouseY;
-            glfwGetCursorPos(window, &mouseX, &mouseY);
-            glm::vec3 rayOrigin, rayDirection;
-            //glm::unProject(glm::vec3(mouseX, mouseY, 0.0f),);
+    }
+    if (button == GLFW_MOUSE_BUTTON_MIDDLE && action == GLFW_RELEASE) {
+        RaycastHit hit;
+        if (pickBlock(hit) && hit.distance > 0.0f) {
+            // The new block goes against the face that was looked at
+            int x = hit.block[0] + hit.normal[0];
+            int y = hit.block[1] + hit.normal[1];
+            int z = hit.block[2] + hit.normal[2];
+            // Blocks can't go where the camera is standing
+            glm::vec3 minA = camera.getMinBounds();
+            glm::vec3 maxA = camera.getMaxBounds();
+            bool insideCamera = x + 0.5f > minA.x && x - 0.5f < maxA.x && y + 0.5f > minA.y && y - 0.5f < maxA.y &&
+                                z + 0.5f > minA.z && z - 0.5f < maxA.z;
+            if (y >= 0 && y < CHUNK_HEIGHT && !insideCamera) {
+                editBlock(x, y, z, placeBlockType);
+            }
         }
     }
 }
 
-void createPointLight(int index, Shader& lightingShader) {
-    // Use the index to correctly reference the specific point light in the shader
-    std::string baseName = "pointLights[" + std::to_string(index) + "]";
-    
-    lightingShader.setVec3(baseName + ".position", pointLightPositions[index]); // Keep lamp position
-    lightingShader.setVec3(baseName + ".ambient", 0.3f, 0.24f, 0.14f); // Warm ambient light (low intensity)
-    lightingShader.setVec3(baseName + ".diffuse", 0.7f, 0.5f, 0.3f); // Warm diffuse light (higher than ambient)
-    lightingShader.setVec3(baseName + ".specular", 1.0f, 0.9f, 0.8f); // Slightly warm specular highlights
-    lightingShader.setFloat(baseName + ".constant", 1.0f); // Standard constant term
-    lightingShader.setFloat(baseName + ".linear", 0.18f); // Higher linear attenuation for small range
-    lightingShader.setFloat(baseName + ".quadratic", 0.12f); // Higher quadratic attenuation for rapid falloff
-    lightingShader.setBool("bilin", bilin); // Keep Blinn-Phong if applicable
-    lightingShader.setBool("gamma", gamma); // Apply gamma correction if enabled
+bool pickBlock(RaycastHit& hit) {
+    const float origin[3] = { camera.renderPosition.x, camera.renderPosition.y, camera.renderPosition.z };
+    const float direction[3] = { camera.Front.x, camera.Front.y, camera.Front.z };
+    return raycastWorld(world, origin, direction, BLOCK_REACH, hit);
+}
 
-    
+/*
+Changes one block and remeshes only the chunks it touches, an edit never rebuilds the whole world.
+Only loaded chunks can be edited, setBlock would make an empty chunk there that the streamer then never fills in.
+*/
+void editBlock(int x, int y, int z, BlockID block) {
+    if (!world.getChunk(VoxelWorld::chunkCoordOf(x, z))) {
+        return;
+    }
+    world.setBlock(x, y, z, block);
+    markBlockDirty(x, z);
+    chunkStreamer.chunkEdited(VoxelWorld::chunkCoordOf(x, z));
 }
 
-void configureMatricesAndShaders() {
+PointLightData createPointLight(glm::vec3 position) {
+    PointLightData light;
+    light.position = position; // Keep lamp position
+    light.ambient = glm::vec3(0.3f, 0.24f, 0.14f); // Warm ambient light (low intensity)
+    light.diffuse = glm::vec3(0.7f, 0.5f, 0.3f); // Warm diffuse light (higher than ambient)
+    light.specular = glm::vec3(1.0f, 0.9f, 0.8f); // Slightly warm specular highlights
+    light.constant = 1.0f; // Standard constant term
+    light.linear = 0.18f; // Higher linear attenuation for small range
+    light.quadratic = 0.12f; // Higher quadratic attenuation for rapid falloff
+    return light;
+}
 
-    lightingShader.use();
-    lightingShader.setVec3("viewPos", camera.Position);
-    lightingShader.setFloat("material.shininess", 2.0f);
-    dayCycle(deltaTime, lightingShader);
-    for(int i = 0; i < pointLightCount; i++) {
-        createPointLight(i, lightingShader);
-    }
+void configureMatricesAndShaders(Shader& shader) {
+
+    shader.use();
+    frameData.viewPos = camera.renderPosition;
+    frameData.shininess = 2.0f;
+    frameData.blinn = bilin; // Keep Blinn-Phong if applicable
+    frameData.gamma = gamma; // Apply gamma correction if enabled
+    dayCycle(deltaTime, frameData.sun);
     // view/projection transformations
-    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 500.0f);
-    glm::mat4 view = camera.GetViewMatrix();
-    lightingShader.setMat4("projection", projection);
-    lightingShader.setMat4("view", view);
-    lightingShader.setInt("pointLightCount", pointLightCount);
+    float aspect = (float)SCR_WIDTH / (float)SCR_HEIGHT;
+    frameData.projection = glm::perspective(glm::radians(camera.Zoom), aspect, 0.1f, 500.0f);
+    frameData.view = camera.GetViewMatrix();
+    frameData.pointLightCount = pointLights.count();
+
+    lightClusters.setProjection(glm::radians(camera.Zoom), aspect, 0.1f, 500.0f);
+    lightClusters.build(frameData.view, pointLights.positionData(), pointLights.radiusData(), pointLights.slotCount());
+    frameData.clusterZScale = lightClusters.zScale();
+    frameData.clusterZBias = lightClusters.zBias();
+    frameData.clusterTileScale = glm::vec2((float)CLUSTER_COUNT_X / framebufferWidth, (float)CLUSTER_COUNT_Y / framebufferHeight);
+    clusterGridBuffer.update(lightClusters.grid().data(), lightClusters.grid().size() * sizeof(uint32_t));
+    clusterIndexBuffer.update(lightClusters.indices().data(), lightClusters.indices().size() * sizeof(uint32_t));
+    clusterGridBuffer.bind(CLUSTER_GRID_UNIT);
+    clusterIndexBuffer.bind(CLUSTER_INDEX_UNIT);
+    packFrameData(frameData, uniformBytes);
+    frameUniformBuffer.update(uniformBytes);
+    // The registry has doubled, it has marked every light to be sent again into the bigger buffer
+    if (lightStorageBuffer.size() < pointLights.storageSize()) {
+        lightStorageBuffer.resize(pointLights.storageSize());
+    }
+    pointLights.flush([](const std::vector<uint8_t>& bytes, size_t offset) {
+        lightStorageBuffer.update(bytes, offset);
+    });
 }
 
-void renderScene(GLFWwindow* window, Shader shader) {
+void renderScene(GLFWwindow* window, Shader& shader) {
     glm::mat4 model = glm::mat4(1.0f);
     shader.setMat4("model", model);
-    drawWorld(cubeVAO, &shader);
+    if (useChunkMeshes) {
+        drawChunks(shader);
+    }
+    else {
+        // The instanced cubes are only rebuilt when they are being drawn and the streamer has changed the world
+        if (chunkStreamer.worldChanged) {
+            buildInstances(world);
+            updateInstanceData();
+            chunkStreamer.worldChanged = false;
+        }
+        drawWorld(cubeVAO, &shader);
+        instanceRing->fenceReads();
+    }
 };
 
-void initializeBuffers(unsigned int* VAO, unsigned int* instanceVBO, unsigned int* VBO, unsigned int* EBO) {
+void initializeBuffers(unsigned int* VAO, unsigned int* VBO, unsigned int* EBO) {
     glGenVertexArrays(1, VAO);
     glGenBuffers(1, VBO);
-    glGenBuffers(1, instanceVBO);
     glGenBuffers(1, EBO); // Generate the EBO
 
     glBindVertexArray(*VAO);
@@ -424,24 +660,43 @@ void initializeBuffers(unsigned int* VAO, unsigned int* instanceVBO, unsigned in
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
     glEnableVertexAttribArray(2); // Texture coords
 
-    // Set up instance data
-    glBindBuffer(GL_ARRAY_BUFFER, *instanceVBO);
-    glBufferData(GL_ARRAY_BUFFER, instancePositions.size() * sizeof(glm::vec3), instancePositions.data(), GL_DYNAMIC_DRAW);
-
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
-    glEnableVertexAttribArray(3); // Instance position
-    glVertexAttribDivisor(3, 1);  // Set attribute divisor for instancing
-
     /*
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, *EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
     */
     glBindVertexArray(0);
+
+    // Instance data comes from the upload ring
+    bindInstanceBuffer();
 }
 
 
+// Points the instance attributes of the cube VAO at the upload ring's buffer, the draw picks the section with instanceBase
+void bindInstanceBuffer() {
+    glBindVertexArray(cubeVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceRing->buffer());
+
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(BlockInstance), (void*)0);
+    glEnableVertexAttribArray(3); // Instance position
+    glVertexAttribDivisor(3, 1);  // Set attribute divisor for instancing
+    glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(BlockInstance), (void*)offsetof(BlockInstance, layer));
+    glEnableVertexAttribArray(4); // Instance texture layer
+    glVertexAttribDivisor(4, 1);
+
+    glBindVertexArray(0);
+    instanceBufferGeneration = instanceRing->bufferGeneration();
+}
+
 void updateInstanceData() {
-    // Update the instance VBO with new positions
-    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
-    glBufferData(GL_ARRAY_BUFFER, instancePositions.size() * sizeof(glm::vec3), instancePositions.data(), GL_DYNAMIC_DRAW);
+    size_t offset = instanceRing->write(blockInstances.data(), blockInstances.size() * sizeof(BlockInstance));
+    if (offset == (size_t)-1) {
+        printf("Failed to upload %zu instances\n", blockInstances.size());
+        blockInstances.clear();
+        return;
+    }
+    instanceBase = (unsigned int)(offset / sizeof(BlockInstance));
+    // The ring makes a new buffer when the instances outgrow it
+    if (instanceRing->bufferGeneration() != instanceBufferGeneration) {
+        bindInstanceBuffer();
+    }
 }
\ No newline at end of file
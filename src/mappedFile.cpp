@@ -0,0 +1,70 @@
+#include <stddef.h>
+#include "mappedFile.h"
+
+#ifdef _WIN32
+// The min and max macros would break std::min and glm
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+bool openMappedFile(const char* filename, uint64_t size, MappedFile* mapped) {
+    mapped->size = size;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, NULL);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+    void* data = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, (SIZE_T)size);
+    if (!data) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    mapped->file = file;
+    mapped->mapping = mapping;
+    mapped->data = (uint8_t*)data;
+#else
+    int file = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file < 0) {
+        return false;
+    }
+    if (ftruncate(file, (off_t)size) != 0) {
+        close(file);
+        return false;
+    }
+    void* data = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    if (data == MAP_FAILED) {
+        close(file);
+        return false;
+    }
+    mapped->file = file;
+    mapped->data = (uint8_t*)data;
+#endif
+    return true;
+}
+
+void closeMappedFile(MappedFile* mapped) {
+#ifdef _WIN32
+    UnmapViewOfFile(mapped->data);
+    CloseHandle(mapped->mapping);
+    CloseHandle(mapped->file);
+#else
+    munmap(mapped->data, (size_t)mapped->size);
+    close(mapped->file);
+#endif
+    mapped->data = NULL;
+}
@@ -0,0 +1,28 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <stdint.h>
+
+/*
+Mapping files needs windows.h on Windows, which clashes with glad's APIENTRY when it comes after the OpenGL headers.
+Only mappedFile.cpp includes it, so nothing that includes this sees it.
+*/
+
+// A file mapped straight into memory, the operating system pages it out to disk so it can be bigger than RAM
+typedef struct {
+    uint8_t* data;
+    uint64_t size;
+#ifdef _WIN32
+    void* file;
+    void* mapping;
+#else
+    int file;
+#endif
+} MappedFile;
+
+// Creates (or replaces) a file of the given size and maps it for writing, returns false if this fails
+bool openMappedFile(const char* filename, uint64_t size, MappedFile* mapped);
+
+void closeMappedFile(MappedFile* mapped);
+
+#endif
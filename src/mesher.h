@@ -0,0 +1,308 @@
+#ifndef MESHER_H
+#define MESHER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "world.h"
+
+/*
+One vertex of a chunk mesh packed into two 32 bit numbers, a quarter of the size of the float vertices in cube.h.
+position: x (bits 0-4), y (bits 5-11), z (bits 12-16) inside the chunk and the face's normal index (bits 17-19)
+material: texture u (bits 0-7), texture v (bits 8-15) and the texture layer (bits 16-31)
+*/
+struct PackedVertex
+{
+    uint32_t position;
+    uint32_t material;
+};
+
+// The six directions a face can point, the shader has a matching table of normals
+enum FaceDirection
+{
+    FACE_NEG_X,
+    FACE_POS_X,
+    FACE_NEG_Y,
+    FACE_POS_Y,
+    FACE_NEG_Z,
+    FACE_POS_Z
+};
+
+inline PackedVertex packVertex(int x, int y, int z, int normal, int u, int v, int layer) {
+    PackedVertex vertex;
+    vertex.position = (uint32_t)x | ((uint32_t)y << 5) | ((uint32_t)z << 12) | ((uint32_t)normal << 17);
+    vertex.material = (uint32_t)u | ((uint32_t)v << 8) | ((uint32_t)layer << 16);
+    return vertex;
+}
+
+inline void unpackVertex(PackedVertex vertex, int& x, int& y, int& z, int& normal, int& u, int& v, int& layer) {
+    x = vertex.position & 0x1F;
+    y = (vertex.position >> 5) & 0x7F;
+    z = (vertex.position >> 12) & 0x1F;
+    normal = (vertex.position >> 17) & 0x7;
+    u = vertex.material & 0xFF;
+    v = (vertex.material >> 8) & 0xFF;
+    layer = vertex.material >> 16;
+}
+
+// The layer of the block texture array a block is drawn with, these line up with TextureID in cube.h
+inline int blockTextureLayer(BlockID block) {
+    return (int)block - 1;
+}
+
+/*
+One cube drawn by the instanced renderer, read by lighting.vs as a vec3 position and an unsigned int texture layer.
+Every block type shares one texture array, so a single instanced draw covers every material.
+*/
+struct BlockInstance
+{
+    float x;
+    float y;
+    float z;
+    uint32_t layer;
+};
+
+inline BlockInstance packBlockInstance(int x, int y, int z, BlockID block) {
+    BlockInstance instance;
+    instance.x = (float)x;
+    instance.y = (float)y;
+    instance.z = (float)z;
+    instance.layer = (uint32_t)blockTextureLayer(block);
+    return instance;
+}
+
+// Fills out with an instance for every block that can be seen, blocks buried on all six sides are skipped. Returns how many blocks there are
+inline size_t buildBlockInstances(const VoxelWorld& world, std::vector<BlockInstance>& out) {
+    out.clear();
+    return world.forEachExposedBlock([&](int x, int y, int z, BlockID block) {
+        out.push_back(packBlockInstance(x, y, z, block));
+    });
+}
+
+/*
+Adds the two triangles of one face to out. The face lies on the plane at plane along axis (0 = x, 1 = y, 2 = z) and
+covers width blocks along the next axis and height blocks along the one after, starting from (start0, start1).
+Front faces are wound clockwise to match glFrontFace(GL_CW).
+*/
+inline void emitQuad(std::vector<PackedVertex>& out, int axis, bool positive, int plane, int start0, int start1, int width, int height, int layer) {
+    int axis0 = (axis + 1) % 3;
+    int axis1 = (axis + 2) % 3;
+    int normal = axis * 2 + (positive ? 1 : 0);
+
+    // The corners go anticlockwise when looked at from the positive side of the axis
+    const int corners[4][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+    PackedVertex quad[4];
+    for (int i = 0; i < 4; i++) {
+        int pos[3];
+        pos[axis] = plane;
+        pos[axis0] = start0 + corners[i][0] * width;
+        pos[axis1] = start1 + corners[i][1] * height;
+        int along0 = corners[i][0] * width;
+        int along1 = corners[i][1] * height;
+        // Side faces keep v pointing up the y axis so textures aren't sideways
+        int u = axis == 0 ? along1 : along0;
+        int v = axis == 0 ? along0 : along1;
+        quad[i] = packVertex(pos[0], pos[1], pos[2], normal, u, v, layer);
+    }
+
+    // Seen from outside a positive face the corners are anticlockwise, so they are flipped to make it clockwise
+    static const int clockwise[6] = { 0, 2, 1, 0, 3, 2 };
+    static const int anticlockwise[6] = { 0, 1, 2, 0, 2, 3 };
+    const int* order = positive ? clockwise : anticlockwise;
+    for (int i = 0; i < 6; i++) {
+        out.push_back(quad[order[i]]);
+    }
+}
+
+// Counts from the last meshing, used to check how much the mesh was reduced by
+struct MeshStats
+{
+    size_t blocks;
+    size_t quads;
+};
+
+typedef enum {
+    MESH_CULLED, // One quad for every face that touches air
+    MESH_GREEDY  // Touching faces of the same block type are merged into as few rectangles as possible
+} MeshMode;
+
+// Tells whether there is a block at a position inside the chunk, looking through the world for positions outside it
+struct ChunkNeighbourhood
+{
+    const VoxelWorld& world;
+    const Chunk& chunk;
+
+    bool solidAt(int x, int y, int z) const {
+        if (y < 0) {
+            return true; // Nothing can see the bottom of the world
+        }
+        if (x >= 0 && x < CHUNK_SIZE && z >= 0 && z < CHUNK_SIZE && y < CHUNK_HEIGHT) {
+            return chunk.get(x, y, z) != BLOCK_AIR;
+        }
+        return world.isSolid(chunk.coord.x * CHUNK_SIZE + x, y, chunk.coord.z * CHUNK_SIZE + z);
+    }
+};
+
+/*
+Builds the mesh of one chunk into out, only faces that border air get a quad so faces shared by two blocks are never drawn.
+Neighbours in other chunks are looked up through the world. This only touches the CPU so it can be run without a window.
+*/
+inline MeshStats meshChunkCulled(const VoxelWorld& world, const Chunk& chunk, std::vector<PackedVertex>& out) {
+    MeshStats stats = { 0, 0 };
+    out.clear();
+    ChunkNeighbourhood area = { world, chunk };
+
+    for (int y = 0; y < CHUNK_HEIGHT; y++) {
+        for (int z = 0; z < CHUNK_SIZE; z++) {
+            for (int x = 0; x < CHUNK_SIZE; x++) {
+                BlockID block = chunk.get(x, y, z);
+                if (block == BLOCK_AIR) {
+                    continue;
+                }
+                stats.blocks++;
+                int layer = blockTextureLayer(block);
+                int pos[3] = { x, y, z };
+                for (int axis = 0; axis < 3; axis++) {
+                    for (int side = 0; side < 2; side++) {
+                        int neighbour[3] = { x, y, z };
+                        neighbour[axis] += side ? 1 : -1;
+                        if (area.solidAt(neighbour[0], neighbour[1], neighbour[2])) {
+                            continue;
+                        }
+                        int plane = pos[axis] + side;
+                        emitQuad(out, axis, side == 1, plane, pos[(axis + 1) % 3], pos[(axis + 2) % 3], 1, 1, layer);
+                        stats.quads++;
+                    }
+                }
+            }
+        }
+    }
+    return stats;
+}
+
+/*
+Builds the same surface as meshChunkCulled but with far fewer quads. Each slice of the chunk facing each direction is
+turned into a mask of which faces can be seen and what they look like, then the mask is covered with the biggest
+rectangles of matching faces that fit, growing each one along the first axis and then the second.
+*/
+inline MeshStats meshChunkGreedy(const VoxelWorld& world, const Chunk& chunk, std::vector<PackedVertex>& out) {
+    MeshStats stats = { 0, 0 };
+    out.clear();
+    ChunkNeighbourhood area = { world, chunk };
+    // Big enough for the largest slice, which is CHUNK_SIZE x CHUNK_HEIGHT. Holds the texture layer + 1, or 0 for no face.
+    int mask[CHUNK_SIZE * CHUNK_HEIGHT];
+
+    // Nothing above the highest block has a face, so the slices are only made as tall as the blocks in the chunk go
+    int top = 0;
+    for (int i = 0; i < CHUNK_SIZE * CHUNK_HEIGHT * CHUNK_SIZE; i++) {
+        if (chunk.blocks[i] != BLOCK_AIR) {
+            stats.blocks++;
+            top = i / (CHUNK_SIZE * CHUNK_SIZE) + 1;
+        }
+    }
+    const int size[3] = { CHUNK_SIZE, top, CHUNK_SIZE };
+
+    for (int axis = 0; axis < 3; axis++) {
+        int axis0 = (axis + 1) % 3;
+        int axis1 = (axis + 2) % 3;
+        int width = size[axis0];
+        int height = size[axis1];
+
+        for (int side = 0; side < 2; side++) {
+            for (int slice = 0; slice < size[axis]; slice++) {
+                // Work out which faces in this slice can be seen
+                bool anyFaces = false;
+                for (int b = 0; b < height; b++) {
+                    for (int a = 0; a < width; a++) {
+                        int pos[3];
+                        pos[axis] = slice;
+                        pos[axis0] = a;
+                        pos[axis1] = b;
+                        int face = 0;
+                        BlockID block = chunk.get(pos[0], pos[1], pos[2]);
+                        if (block != BLOCK_AIR) {
+                            pos[axis] += side ? 1 : -1;
+                            if (!area.solidAt(pos[0], pos[1], pos[2])) {
+                                face = blockTextureLayer(block) + 1;
+                                anyFaces = true;
+                            }
+                        }
+                        mask[b * width + a] = face;
+                    }
+                }
+                if (!anyFaces) {
+                    continue;
+                }
+
+                // Cover the mask with rectangles
+                for (int b = 0; b < height; b++) {
+                    for (int a = 0; a < width; ) {
+                        int face = mask[b * width + a];
+                        if (face == 0) {
+                            a++;
+                            continue;
+                        }
+                        int quadWidth = 1;
+                        while (a + quadWidth < width && mask[b * width + a + quadWidth] == face) {
+                            quadWidth++;
+                        }
+                        int quadHeight = 1;
+                        while (b + quadHeight < height) {
+                            bool rowMatches = true;
+                            for (int k = 0; k < quadWidth; k++) {
+                                if (mask[(b + quadHeight) * width + a + k] != face) {
+                                    rowMatches = false;
+                                    break;
+                                }
+                            }
+                            if (!rowMatches) {
+                                break;
+                            }
+                            quadHeight++;
+                        }
+
+                        emitQuad(out, axis, side == 1, slice + side, a, b, quadWidth, quadHeight, face - 1);
+                        stats.quads++;
+
+                        // Clear the faces that have been covered so they aren't used again
+                        for (int h = 0; h < quadHeight; h++) {
+                            for (int k = 0; k < quadWidth; k++) {
+                                mask[(b + h) * width + a + k] = 0;
+                            }
+                        }
+                        a += quadWidth;
+                    }
+                }
+            }
+        }
+    }
+    return stats;
+}
+
+inline MeshStats meshChunk(const VoxelWorld& world, const Chunk& chunk, std::vector<PackedVertex>& out, MeshMode mode = MESH_CULLED) {
+    return mode == MESH_GREEDY ? meshChunkGreedy(world, chunk, out) : meshChunkCulled(world, chunk, out);
+}
+
+// Meshes every chunk of the world with both modes and prints how many quads each makes and how long it takes
+inline void benchmarkMesher(const VoxelWorld& world) {
+    std::vector<PackedVertex> vertices;
+    size_t chunks = world.chunkCount();
+    if (chunks == 0) {
+        return;
+    }
+    const char* names[2] = { "culled", "greedy" };
+    for (int mode = MESH_CULLED; mode <= MESH_GREEDY; mode++) {
+        size_t quads = 0;
+        auto start = std::chrono::steady_clock::now();
+        world.forEachChunk([&](const Chunk& chunk) {
+            quads += meshChunk(world, chunk, vertices, (MeshMode)mode).quads;
+        });
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        printf("Mesher (%s): %zu quads, %.1f quads per chunk, %.2f ms total, %.3f ms per chunk\n",
+               names[mode], quads, (double)quads / chunks, milliseconds, milliseconds / chunks);
+    }
+}
+
+#endif
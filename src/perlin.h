@@ -1,8 +1,28 @@
+#ifndef PERLIN_H
+#define PERLIN_H
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <math.h>
 #include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include "threadPool.h"
+#include "mappedFile.h"
+
+// The batch row evaluator has hand written SSE4.1 and AVX2 kernels, these are only built on x86 and picked at runtime
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PERLIN_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define PERLIN_TARGET(isa)
+#else
+#define PERLIN_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
 
 typedef struct {
     float x;
@@ -33,8 +53,32 @@ typedef struct {
 } BITMAPINFOHEADER;
 #pragma pack(pop)
 
+typedef enum {
+    GRADIENT_ANGLE, // The hash is turned into an angle and then into a vector using sin and cos, this is what older seeds were made with
+    GRADIENT_TABLE  // The hash picks one of the directions in gradientTable, no sin or cos needed
+} GradientMode;
+
+#define GRADIENT_TABLE_SIZE 256
+
+// Unit vectors spread evenly around the circle, aligned to a cache line so the whole table sits in as few lines as possible
+typedef struct {
+    alignas(64) vector2 directions[GRADIENT_TABLE_SIZE];
+} GradientTable;
+
+GradientTable createGradientTable() {
+    GradientTable table;
+    for (int i = 0; i < GRADIENT_TABLE_SIZE; i++) {
+        float angle = i * (2.0f * 3.14159265f / GRADIENT_TABLE_SIZE);
+        table.directions[i].x = sin(angle);
+        table.directions[i].y = cos(angle);
+    }
+    return table;
+}
+
+const GradientTable gradientTable = createGradientTable();
+
 // Creates a psuedo-Random value using a seed values, this is done so that the result of the alorithim can be replicated in perlin noise generation
-vector2 randomGradient(int ix, int iy, int seed) {
+vector2 randomGradient(int ix, int iy, int seed, GradientMode mode = GRADIENT_ANGLE) {
     const unsigned w = 8 * sizeof(unsigned);
     const unsigned s = w / 2; 
     unsigned a = ix + seed, b = iy + seed;
@@ -47,6 +91,11 @@ vector2 randomGradient(int ix, int iy, int seed) {
     a ^= b << s | b >> (w - s);
     a *= 2048419325;
 
+    if (mode == GRADIENT_TABLE) {
+        // The top bits of a are the best mixed so they are used to pick the direction
+        return gradientTable.directions[a >> (w - 8)];
+    }
+
     // Weighs the result of a to from 0 to 2 radiants
     float random = a * (3.14159265 / ~(~0u >> 1)); // [0, 2*Pi]
     //Creates a vector value ranging from -1 to 0
@@ -54,9 +103,9 @@ vector2 randomGradient(int ix, int iy, int seed) {
     return v;
 }
 
-float dotProduct(int ix, int iy, float x, float y, int seed) {
+float dotProduct(int ix, int iy, float x, float y, int seed, GradientMode mode = GRADIENT_ANGLE) {
     // Creates a random Gradient for usage in creating a random value for producing a dot product value between the corners and interception point
-    vector2 grad = randomGradient(ix, iy, seed);
+    vector2 grad = randomGradient(ix, iy, seed, mode);
 
     // Obtains the fractionial parts of x and y
     float dx = x - (float)ix;
@@ -69,7 +118,7 @@ float smoothStep(float a, float b, float w) {
     return (b - a) * (3.0 - w * 2.0) * w * w + a;
 }
 
-float perlinNoise(float x, float y, int seed) {
+float perlinNoise(float x, float y, int seed, GradientMode mode = GRADIENT_ANGLE) {
     int x0 = (int)x;
     int y0 = (int)y;
     int x1 = x0 + 1;
@@ -79,50 +128,459 @@ float perlinNoise(float x, float y, int seed) {
     float yf = y - (float)y0;
 
     // Creates the values of the bottom left and bottom right corners using the dot product function to make the noise have a gradient effect
-    float c0 = dotProduct(x0, y0, x, y, seed);
-    float c1 = dotProduct(x1, y0, x, y, seed);
+    float c0 = dotProduct(x0, y0, x, y, seed, mode);
+    float c1 = dotProduct(x1, y0, x, y, seed, mode);
     // Makes the noise look "Smoother"
     float val1 = smoothStep(c0, c1, xf);
 
     //Top left and Top right this time
-    float c2 = dotProduct(x0, y1, x, y, seed);
-    float c3 = dotProduct(x1, y1, x, y, seed);
+    float c2 = dotProduct(x0, y1, x, y, seed, mode);
+    float c3 = dotProduct(x1, y1, x, y, seed, mode);
     float val2 = smoothStep(c2, c3, xf);
 
     // Returns the noise value using the given coordinates
     return smoothStep(val1, val2, yf);
 }
 
-void writeBMP(const char* filename, int* pixels, int width, int height) {
-    FILE* file = fopen(filename, "wb");
-    // Simple Error Handling to see if the application has opened or created the file correctly
-    if (!file) {
-        perror("Failed to create file!\n");
+typedef enum {
+    PERLIN_KERNEL_SCALAR,
+    PERLIN_KERNEL_SSE41,
+    PERLIN_KERNEL_AVX2
+} PerlinKernel; // Which implementation perlinNoiseRow uses.
+
+// Asks the CPU which instruction sets it supports so the fastest row kernel can be used
+PerlinKernel detectPerlinKernel() {
+#if defined(PERLIN_X86) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return PERLIN_KERNEL_AVX2;
+    if (__builtin_cpu_supports("sse4.1")) return PERLIN_KERNEL_SSE41;
+#elif defined(PERLIN_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool sse41 = (info[2] & (1 << 19)) != 0;
+    // AVX registers can only be used if the operating system saves them when switching threads (OSXSAVE + XCR0)
+    bool osAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+    __cpuidex(info, 7, 0);
+    if (osAvx && (info[1] & (1 << 5))) return PERLIN_KERNEL_AVX2;
+    if (sse41) return PERLIN_KERNEL_SSE41;
+#endif
+    return PERLIN_KERNEL_SCALAR;
+}
+
+// The kernel used by perlinNoiseRow, this can be set to PERLIN_KERNEL_SCALAR to check the SIMD kernels against it
+PerlinKernel perlinKernel = detectPerlinKernel();
+
+/*
+Row kernels. Every kernel fills out[i] with the noise at ((startX + i) / cellSize, y) and reads the corner gradients
+from grad0 (lattice row y0) and grad1 (lattice row y0 + 1) instead of hashing them, gradBase is the lattice x of grad0[0].
+They do the exact same float and double operations as perlinNoise in the same order so the results match bit for bit.
+*/
+void perlinRowKernelScalar(float* out, int startX, int count, float cellSize, float y, const vector2* grad0, const vector2* grad1, int gradBase) {
+    int y0 = (int)y;
+    float yf = y - (float)y0;
+    float dy0 = y - (float)y0;
+    float dy1 = y - (float)(y0 + 1);
+
+    for (int i = 0; i < count; i++) {
+        float x = (float)(startX + i) / cellSize;
+        int x0 = (int)x;
+        float xf = x - (float)x0;
+        float dx0 = x - (float)x0;
+        float dx1 = x - (float)(x0 + 1);
+        const vector2* g0 = grad0 + (x0 - gradBase);
+        const vector2* g1 = grad1 + (x0 - gradBase);
+
+        float c0 = dx0 * g0[0].x + dy0 * g0[0].y;
+        float c1 = dx1 * g0[1].x + dy0 * g0[1].y;
+        float val1 = smoothStep(c0, c1, xf);
+
+        float c2 = dx0 * g1[0].x + dy1 * g1[0].y;
+        float c3 = dx1 * g1[1].x + dy1 * g1[1].y;
+        float val2 = smoothStep(c2, c3, xf);
+
+        out[i] = smoothStep(val1, val2, yf);
+    }
+}
+
+#ifdef PERLIN_X86
+// smoothStep works in double precision, so two doubles at a time are used here to get the same rounding
+PERLIN_TARGET("sse4.1")
+static inline __m128 smoothStepSSE(__m128 a, __m128 b, __m128 w) {
+    __m128 diff = _mm_sub_ps(b, a);
+    __m128d three = _mm_set1_pd(3.0), two = _mm_set1_pd(2.0);
+    __m128d result[2];
+    for (int half = 0; half < 2; half++) {
+        __m128d d = _mm_cvtps_pd(diff);
+        __m128d wd = _mm_cvtps_pd(w);
+        __m128d ad = _mm_cvtps_pd(a);
+        __m128d r = _mm_mul_pd(d, _mm_sub_pd(three, _mm_mul_pd(wd, two)));
+        r = _mm_mul_pd(r, wd);
+        r = _mm_mul_pd(r, wd);
+        result[half] = _mm_add_pd(r, ad);
+        // Move the upper two lanes down for the second half
+        diff = _mm_movehl_ps(diff, diff);
+        w = _mm_movehl_ps(w, w);
+        a = _mm_movehl_ps(a, a);
+    }
+    return _mm_movelh_ps(_mm_cvtpd_ps(result[0]), _mm_cvtpd_ps(result[1]));
+}
+
+PERLIN_TARGET("sse4.1")
+void perlinRowKernelSSE41(float* out, int startX, int count, float cellSize, float y, const vector2* grad0, const vector2* grad1, int gradBase) {
+    int y0 = (int)y;
+    __m128 yf = _mm_set1_ps(y - (float)y0);
+    __m128 dy0 = _mm_set1_ps(y - (float)y0);
+    __m128 dy1 = _mm_set1_ps(y - (float)(y0 + 1));
+    __m128 cell = _mm_set1_ps(cellSize);
+    __m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+    __m128i one = _mm_set1_epi32(1);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_div_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(startX + i), lanes)), cell);
+        __m128i x0 = _mm_cvttps_epi32(x);
+        __m128 dx0 = _mm_sub_ps(x, _mm_cvtepi32_ps(x0));
+        __m128 dx1 = _mm_sub_ps(x, _mm_cvtepi32_ps(_mm_add_epi32(x0, one)));
+
+        // SSE has no gather instruction so the gradients are loaded one lane at a time
+        alignas(16) int index[4];
+        _mm_store_si128((__m128i*)index, _mm_sub_epi32(x0, _mm_set1_epi32(gradBase)));
+        alignas(16) float g[8][4];
+        for (int lane = 0; lane < 4; lane++) {
+            const vector2* g0 = grad0 + index[lane];
+            const vector2* g1 = grad1 + index[lane];
+            g[0][lane] = g0[0].x; g[1][lane] = g0[0].y;
+            g[2][lane] = g0[1].x; g[3][lane] = g0[1].y;
+            g[4][lane] = g1[0].x; g[5][lane] = g1[0].y;
+            g[6][lane] = g1[1].x; g[7][lane] = g1[1].y;
+        }
+
+        __m128 c0 = _mm_add_ps(_mm_mul_ps(dx0, _mm_load_ps(g[0])), _mm_mul_ps(dy0, _mm_load_ps(g[1])));
+        __m128 c1 = _mm_add_ps(_mm_mul_ps(dx1, _mm_load_ps(g[2])), _mm_mul_ps(dy0, _mm_load_ps(g[3])));
+        __m128 val1 = smoothStepSSE(c0, c1, dx0);
+
+        __m128 c2 = _mm_add_ps(_mm_mul_ps(dx0, _mm_load_ps(g[4])), _mm_mul_ps(dy1, _mm_load_ps(g[5])));
+        __m128 c3 = _mm_add_ps(_mm_mul_ps(dx1, _mm_load_ps(g[6])), _mm_mul_ps(dy1, _mm_load_ps(g[7])));
+        __m128 val2 = smoothStepSSE(c2, c3, dx0);
+
+        _mm_storeu_ps(out + i, smoothStepSSE(val1, val2, yf));
+    }
+    // Whatever doesn't fill a full register is done by the scalar kernel
+    perlinRowKernelScalar(out + i, startX + i, count - i, cellSize, y, grad0, grad1, gradBase);
+}
+
+PERLIN_TARGET("avx2")
+static inline __m256 smoothStepAVX2(__m256 a, __m256 b, __m256 w) {
+    __m256 diff = _mm256_sub_ps(b, a);
+    __m256d three = _mm256_set1_pd(3.0), two = _mm256_set1_pd(2.0);
+    __m256d result[2];
+    for (int half = 0; half < 2; half++) {
+        __m256d d = _mm256_cvtps_pd(half ? _mm256_extractf128_ps(diff, 1) : _mm256_castps256_ps128(diff));
+        __m256d wd = _mm256_cvtps_pd(half ? _mm256_extractf128_ps(w, 1) : _mm256_castps256_ps128(w));
+        __m256d ad = _mm256_cvtps_pd(half ? _mm256_extractf128_ps(a, 1) : _mm256_castps256_ps128(a));
+        __m256d r = _mm256_mul_pd(d, _mm256_sub_pd(three, _mm256_mul_pd(wd, two)));
+        r = _mm256_mul_pd(r, wd);
+        r = _mm256_mul_pd(r, wd);
+        result[half] = _mm256_add_pd(r, ad);
+    }
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(result[0])), _mm256_cvtpd_ps(result[1]), 1);
+}
+
+PERLIN_TARGET("avx2")
+void perlinRowKernelAVX2(float* out, int startX, int count, float cellSize, float y, const vector2* grad0, const vector2* grad1, int gradBase) {
+    int y0 = (int)y;
+    __m256 yf = _mm256_set1_ps(y - (float)y0);
+    __m256 dy0 = _mm256_set1_ps(y - (float)y0);
+    __m256 dy1 = _mm256_set1_ps(y - (float)(y0 + 1));
+    __m256 cell = _mm256_set1_ps(cellSize);
+    __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i one = _mm256_set1_epi32(1);
+    const float* g0 = &grad0[0].x;
+    const float* g1 = &grad1[0].x;
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(startX + i), lanes)), cell);
+        __m256i x0 = _mm256_cvttps_epi32(x);
+        __m256 dx0 = _mm256_sub_ps(x, _mm256_cvtepi32_ps(x0));
+        __m256 dx1 = _mm256_sub_ps(x, _mm256_cvtepi32_ps(_mm256_add_epi32(x0, one)));
+
+        // Each vector2 is two floats, so the float index of a gradient's x is twice its lattice offset
+        __m256i ix = _mm256_slli_epi32(_mm256_sub_epi32(x0, _mm256_set1_epi32(gradBase)), 1);
+        __m256i iy = _mm256_add_epi32(ix, one);
+        __m256i ix1 = _mm256_add_epi32(ix, _mm256_set1_epi32(2));
+        __m256i iy1 = _mm256_add_epi32(ix, _mm256_set1_epi32(3));
+
+        __m256 c0 = _mm256_add_ps(_mm256_mul_ps(dx0, _mm256_i32gather_ps(g0, ix, 4)), _mm256_mul_ps(dy0, _mm256_i32gather_ps(g0, iy, 4)));
+        __m256 c1 = _mm256_add_ps(_mm256_mul_ps(dx1, _mm256_i32gather_ps(g0, ix1, 4)), _mm256_mul_ps(dy0, _mm256_i32gather_ps(g0, iy1, 4)));
+        __m256 val1 = smoothStepAVX2(c0, c1, dx0);
+
+        __m256 c2 = _mm256_add_ps(_mm256_mul_ps(dx0, _mm256_i32gather_ps(g1, ix, 4)), _mm256_mul_ps(dy1, _mm256_i32gather_ps(g1, iy, 4)));
+        __m256 c3 = _mm256_add_ps(_mm256_mul_ps(dx1, _mm256_i32gather_ps(g1, ix1, 4)), _mm256_mul_ps(dy1, _mm256_i32gather_ps(g1, iy1, 4)));
+        __m256 val2 = smoothStepAVX2(c2, c3, dx0);
+
+        _mm256_storeu_ps(out + i, smoothStepAVX2(val1, val2, yf));
+    }
+    perlinRowKernelScalar(out + i, startX + i, count - i, cellSize, y, grad0, grad1, gradBase);
+}
+#endif
+
+// Runs the row kernel picked by perlinKernel
+void perlinRowKernel(float* out, int startX, int count, float cellSize, float y, const vector2* grad0, const vector2* grad1, int gradBase) {
+    switch (perlinKernel) {
+#ifdef PERLIN_X86
+    case PERLIN_KERNEL_AVX2:
+        perlinRowKernelAVX2(out, startX, count, cellSize, y, grad0, grad1, gradBase);
+        break;
+    case PERLIN_KERNEL_SSE41:
+        perlinRowKernelSSE41(out, startX, count, cellSize, y, grad0, grad1, gradBase);
+        break;
+#endif
+    default:
+        perlinRowKernelScalar(out, startX, count, cellSize, y, grad0, grad1, gradBase);
+        break;
+    }
+}
+
+// Fills out with count noise values along one row, the same as calling perlinNoise((startX + i) / cellSize, y, seed, mode) for each i.
+void perlinNoiseRow(float* out, int startX, int count, float cellSize, float y, int seed, GradientMode mode = GRADIENT_ANGLE) {
+    if (count <= 0) {
+        return;
+    }
+    // Every sample in the row shares the same few lattice corners, so each gradient is only hashed once here
+    int y0 = (int)y;
+    int firstX = (int)((float)startX / cellSize);
+    int lastX = (int)((float)(startX + count - 1) / cellSize) + 1;
+    int gradCount = lastX - firstX + 1;
+    vector2* grad0 = (vector2*)malloc(sizeof(vector2) * gradCount * 2);
+    vector2* grad1 = grad0 + gradCount;
+    for (int i = 0; i < gradCount; i++) {
+        grad0[i] = randomGradient(firstX + i, y0, seed, mode);
+        grad1[i] = randomGradient(firstX + i, y0 + 1, seed, mode);
+    }
+
+    perlinRowKernel(out, startX, count, cellSize, y, grad0, grad1, firstX);
+
+    free(grad0);
+}
+
+// The corner gradients of every lattice cell a tile covers, hashed once so every pixel in the cell can share them.
+// gradients is NULL if there wasn't enough memory for them.
+typedef struct {
+    vector2* gradients;
+    int firstX;
+    int firstY;
+    int width;
+    float cellSize;
+} GradientGrid;
+
+GradientGrid createGradientGrid(int startX, int startY, int tileWidth, int tileHeight, float cellSize, int seed, GradientMode mode) {
+    GradientGrid grid;
+    grid.cellSize = cellSize;
+    grid.firstX = (int)((float)startX / cellSize);
+    grid.firstY = (int)((float)startY / cellSize);
+    int lastX = (int)((float)(startX + tileWidth - 1) / cellSize) + 1;
+    int lastY = (int)((float)(startY + tileHeight - 1) / cellSize) + 1;
+    grid.width = lastX - grid.firstX + 1;
+    int height = lastY - grid.firstY + 1;
+
+    grid.gradients = (vector2*)malloc(sizeof(vector2) * grid.width * height);
+    if (!grid.gradients) {
+        printf("Failed to allocate a %d x %d gradient grid\n", grid.width, height);
+        return grid;
+    }
+    for (int gy = 0; gy < height; gy++) {
+        for (int gx = 0; gx < grid.width; gx++) {
+            grid.gradients[gy * grid.width + gx] = randomGradient(grid.firstX + gx, grid.firstY + gy, seed, mode);
+        }
+    }
+    return grid;
+}
+
+// Sweeps one row of pixels using the gradients stored in the grid
+void gradientGridRow(const GradientGrid& grid, float* out, int startX, int count, int pixelY) {
+    float y = pixelY / grid.cellSize;
+    const vector2* grad0 = grid.gradients + ((int)y - grid.firstY) * grid.width;
+    perlinRowKernel(out, startX, count, grid.cellSize, y, grad0, grad0 + grid.width, grid.firstX);
+}
+
+/*
+Fills a tileWidth x tileHeight block of pixels starting at pixel (startX, startY), out is written with stride floats between rows.
+Every pixel in a lattice cell shares the same four corners, so the gradients for every corner the tile touches are hashed once
+into a small grid and then each row is swept by the row kernel reading from that grid. Each pixel's offset from its corners is
+still worked out directly rather than accumulated, which keeps the output bit for bit the same as perlinNoise.
+*/
+void perlinNoiseTile(float* out, int stride, int startX, int startY, int tileWidth, int tileHeight, float cellSize, int seed, GradientMode mode = GRADIENT_ANGLE) {
+    if (tileWidth <= 0 || tileHeight <= 0) {
+        return;
+    }
+    GradientGrid grid = createGradientGrid(startX, startY, tileWidth, tileHeight, cellSize, seed, mode);
+    if (!grid.gradients) {
+        // Flat ground is left rather than garbage
+        for (int row = 0; row < tileHeight; row++) {
+            memset(out + row * stride, 0, sizeof(float) * tileWidth);
+        }
+        return;
+    }
+    for (int row = 0; row < tileHeight; row++) {
+        gradientGridRow(grid, out + row * stride, startX, tileWidth, startY + row);
+    }
+    free(grid.gradients);
+}
+
+typedef enum {
+    FRACTAL_FBM,        // Octaves are added together as they are
+    FRACTAL_TURBULENCE, // The absolute value of each octave is added, giving billowy hills
+    FRACTAL_RIDGED      // Each octave is folded into sharp ridges with (1 - |n|)^2
+} FractalType;
+
+#define MAX_OCTAVES 16
+
+typedef struct {
+    FractalType type;
+    int octaves;                   // Octaves with cells smaller than a pixel are left out, they would only add aliasing
+    float lacunarity;              // How much smaller the cells get each octave
+    float gain;                    // How much quieter each octave is than the last
+    int seedOffsets[MAX_OCTAVES];  // Added to the seed for each octave so the octaves don't line up with each other
+} FractalSettings;
+
+FractalSettings createFractalSettings(FractalType type = FRACTAL_FBM, int octaves = 4, float lacunarity = 2.0f, float gain = 0.5f) {
+    FractalSettings settings;
+    settings.type = type;
+    settings.octaves = octaves < 1 ? 1 : (octaves > MAX_OCTAVES ? MAX_OCTAVES : octaves);
+    if (lacunarity <= 0.0f) {
+        printf("A lacunarity of %f can't scale the cells, using 2 instead\n", lacunarity);
+        lacunarity = 2.0f;
+    }
+    settings.lacunarity = lacunarity;
+    settings.gain = gain;
+    for (int i = 0; i < MAX_OCTAVES; i++) {
+        settings.seedOffsets[i] = i * 7919;
+    }
+    return settings;
+}
+
+/*
+Layers several octaves of noise into a tile in one pass. The gradient grid of every octave is made first, then each row
+runs through all of the octaves at once while the row is still in the cache, so the tile is only written to once.
+Octaves stop once their cells would be smaller than a pixel, a cell that small needs a gradient grid far bigger than the
+tile (gigabytes deep into the 16 octaves) and can't add any detail a pixel can show.
+The result is scaled back into [-1, 1] whatever the type is. With one FBM octave this is the same as perlinNoiseTile.
+*/
+void fractalNoiseTile(float* out, int stride, int startX, int startY, int tileWidth, int tileHeight, float cellSize, int seed, GradientMode mode, const FractalSettings& fractal) {
+    if (tileWidth <= 0 || tileHeight <= 0) {
         return;
     }
+    GradientGrid grids[MAX_OCTAVES];
+    float amplitudes[MAX_OCTAVES];
+    float amplitudeSum = 0.0f;
+    float octaveCellSize = cellSize;
+    float amplitude = 1.0f;
+    int octaves = 0;
+    // The settings can be filled in without createFractalSettings, so the count is clamped again to stay inside the arrays
+    int maxOctaves = std::min(fractal.octaves, MAX_OCTAVES);
+    // The first octave is always made, whatever cell size the caller asked for
+    while (octaves < maxOctaves && (octaves == 0 || octaveCellSize >= 1.0f)) {
+        grids[octaves] = createGradientGrid(startX, startY, tileWidth, tileHeight, octaveCellSize, seed + fractal.seedOffsets[octaves], mode);
+        if (!grids[octaves].gradients) {
+            break;
+        }
+        amplitudes[octaves] = amplitude;
+        amplitudeSum += amplitude;
+        octaveCellSize /= fractal.lacunarity;
+        amplitude *= fractal.gain;
+        octaves++;
+    }
 
-    int rowSize = (3 * width + 3) & ~3; // ~3 Is used here to that the result is in factors of 3
-    uint32_t pixelArraySize = rowSize * height;
+    float* octave = octaves > 0 ? (float*)malloc(sizeof(float) * tileWidth) : NULL;
+    if (!octave) {
+        for (int row = 0; row < tileHeight; row++) {
+            memset(out + row * stride, 0, sizeof(float) * tileWidth);
+        }
+        for (int o = 0; o < octaves; o++) {
+            free(grids[o].gradients);
+        }
+        return;
+    }
+    for (int row = 0; row < tileHeight; row++) {
+        float* values = out + row * stride;
+        for (int o = 0; o < octaves; o++) {
+            gradientGridRow(grids[o], octave, startX, tileWidth, startY + row);
+            for (int x = 0; x < tileWidth; x++) {
+                float n = octave[x];
+                if (fractal.type == FRACTAL_TURBULENCE) {
+                    n = fabsf(n);
+                }
+                else if (fractal.type == FRACTAL_RIDGED) {
+                    n = (1.0f - fabsf(n)) * (1.0f - fabsf(n));
+                }
+                // The first octave is stored rather than added to 0, which would turn a -0 from perlinNoise into +0
+                values[x] = o == 0 ? amplitudes[o] * n : values[x] + amplitudes[o] * n;
+            }
+        }
+        for (int x = 0; x < tileWidth; x++) {
+            float n = values[x] / amplitudeSum;
+            // Turbulence and ridged noise only go from 0 to 1 so they are stretched back out to [-1, 1]
+            values[x] = fractal.type == FRACTAL_FBM ? n : n * 2.0f - 1.0f;
+        }
+    }
+
+    free(octave);
+    for (int o = 0; o < octaves; o++) {
+        free(grids[o].gradients);
+    }
+}
+
+typedef enum {
+    BMP_RGB24,     // Every pixel is written three times as red, green and blue
+    BMP_GRAYSCALE8 // One byte per pixel indexing a grey palette, a third of the size
+} BmpFormat;
+
+// Sizes of the parts of a bitmap file, worked out once so the header and rows can be written separately
+typedef struct {
+    BmpFormat format;
+    int width;
+    int height;
+    uint32_t rowSize;     // Bytes in one row including the padding, rows have to be a multiple of 4 bytes
+    uint32_t headerSize;  // Both headers plus the palette for greyscale images
+    uint64_t fileSize;
+} BmpLayout;
+
+BmpLayout createBMPLayout(int width, int height, BmpFormat format) {
+    BmpLayout layout;
+    layout.format = format;
+    layout.width = width;
+    layout.height = height;
+    int bytesPerPixel = format == BMP_GRAYSCALE8 ? 1 : 3;
+    layout.rowSize = (bytesPerPixel * width + 3) & ~3; // ~3 Is used here so that the result is a multiple of 4
+    layout.headerSize = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER) + (format == BMP_GRAYSCALE8 ? 256 * 4 : 0);
+    layout.fileSize = layout.headerSize + (uint64_t)layout.rowSize * height;
+    return layout;
+}
+
+// Writes both headers (and the palette) into dst, which must have room for layout.headerSize bytes
+void writeBMPHeader(uint8_t* dst, const BmpLayout& layout) {
+    uint32_t pixelArraySize = layout.rowSize * layout.height;
 
     BITMAPFILEHEADER fileHeader = {
         .bfType = 0x4D42,
-        .bfSize = (uint32_t)(sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER) + pixelArraySize),
+        .bfSize = (uint32_t)layout.fileSize,
         .bfReserved1 = 0,
         .bfReserved2 = 0,
-        .bfOffBits = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER)
+        .bfOffBits = layout.headerSize
     };
 
     BITMAPINFOHEADER fileInfoHeader = {
         .biSize = sizeof(BITMAPINFOHEADER),
-        .biWidth = width,
-        .biHeight = -height, 
+        .biWidth = layout.width,
+        .biHeight = -layout.height, // Negative so the rows are stored top to bottom, letting them be written in order
         .biPlanes = 1,
-        .biBitCount = 24,
+        .biBitCount = (uint16_t)(layout.format == BMP_GRAYSCALE8 ? 8 : 24),
         .biCompression = 0,
         .biSizeImage = pixelArraySize,
         .biXpelsPerMeter = 0,
         .biYpelsPerMeter = 0,
-        .biClrUsed = 0,
+        .biClrUsed = (uint32_t)(layout.format == BMP_GRAYSCALE8 ? 256 : 0),
         .biClrImportant = 0
     };
 
@@ -130,44 +588,226 @@ void writeBMP(const char* filename, int* pixels, int width, int height) {
     Write both the headers to the file so that the data can be added afterwards. 
     This is done so that the operating system can understand what type of file this is and how to display it.
     */
-    fwrite(&fileHeader, sizeof(BITMAPFILEHEADER), 1, file);
-    fwrite(&fileInfoHeader, sizeof(BITMAPINFOHEADER), 1, file);
+    memcpy(dst, &fileHeader, sizeof(BITMAPFILEHEADER));
+    dst += sizeof(BITMAPFILEHEADER);
+    memcpy(dst, &fileInfoHeader, sizeof(BITMAPINFOHEADER));
+    dst += sizeof(BITMAPINFOHEADER);
+
+    if (layout.format == BMP_GRAYSCALE8) {
+        // Palette entry i is the grey colour i, stored as blue, green, red, reserved
+        for (int i = 0; i < 256; i++) {
+            dst[i * 4 + 0] = (uint8_t)i;
+            dst[i * 4 + 1] = (uint8_t)i;
+            dst[i * 4 + 2] = (uint8_t)i;
+            dst[i * 4 + 3] = 0;
+        }
+    }
+}
+
+// Turns one row of heights into the bytes of a bitmap row, padding included
+void encodeBMPRow(uint8_t* dst, const uint8_t* pixels, const BmpLayout& layout) {
+    uint32_t used;
+    if (layout.format == BMP_GRAYSCALE8) {
+        memcpy(dst, pixels, layout.width);
+        used = layout.width;
+    }
+    else {
+        for (int x = 0; x < layout.width; x++) {
+            dst[x * 3 + 0] = pixels[x]; // Blue
+            dst[x * 3 + 1] = pixels[x]; // Green
+            dst[x * 3 + 2] = pixels[x]; // Red
+        }
+        used = layout.width * 3;
+    }
+    memset(dst + used, 0, layout.rowSize - used);
+}
 
-    uint8_t padding[3] = { 0, 0, 0 };
+/*
+Saves the heights as a bitmap. The rows are built up in a buffer of around a megabyte and written with one fwrite for the
+whole buffer, small images end up as a single write. With useMmap the file is mapped into memory and the rows are encoded
+straight into it, for images too big to comfortably fit in RAM.
+*/
+void writeBMP(const char* filename, const uint8_t* pixels, int width, int height, BmpFormat format = BMP_RGB24, bool useMmap = false) {
+    BmpLayout layout = createBMPLayout(width, height, format);
+
+    if (useMmap) {
+        MappedFile mapped;
+        if (openMappedFile(filename, layout.fileSize, &mapped)) {
+            writeBMPHeader(mapped.data, layout);
+            for (int y = 0; y < height; y++) {
+                encodeBMPRow(mapped.data + layout.headerSize + (uint64_t)y * layout.rowSize, pixels + (size_t)y * width, layout);
+            }
+            closeMappedFile(&mapped);
+            return;
+        }
+        perror("Failed to map file, writing it normally instead");
+    }
+
+    FILE* file = fopen(filename, "wb");
+    // Simple Error Handling to see if the application has opened or created the file correctly
+    if (!file) {
+        perror("Failed to create file!\n");
+        return;
+    }
+
+    int rowsPerWrite = (1 << 20) / layout.rowSize;
+    if (rowsPerWrite < 1) {
+        rowsPerWrite = 1;
+    }
+    if (rowsPerWrite > height) {
+        rowsPerWrite = height;
+    }
+    // The header goes at the front of the first buffer so small images only need one write
+    uint8_t* buffer = (uint8_t*)malloc(layout.headerSize + (size_t)rowsPerWrite * layout.rowSize);
+    if (!buffer) {
+        perror("Failed to allocate the bitmap buffer!\n");
+        fclose(file);
+        return;
+    }
+    writeBMPHeader(buffer, layout);
+    size_t used = layout.headerSize;
 
     for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            uint8_t pixel = (uint8_t)pixels[y * width + x];
-            fwrite(&pixel, 1, 1, file); // Red
-            fwrite(&pixel, 1, 1, file); // Green
-            fwrite(&pixel, 1, 1, file);  // Blue
+        encodeBMPRow(buffer + used, pixels + (size_t)y * width, layout);
+        used += layout.rowSize;
+        if ((y + 1) % rowsPerWrite == 0 || y == height - 1) {
+            // Write the pixel data to the file.
+            if (fwrite(buffer, 1, used, file) != used) {
+                perror("Failed to write file!\n");
+                free(buffer);
+                fclose(file);
+                return;
+            }
+            used = 0;
         }
-        fwrite(padding, 1, (rowSize - width * 3), file); // Write the pixel data to the file.
+    }
+    // Only the header is left when the image has no rows
+    if (used > 0 && fwrite(buffer, 1, used, file) != used) {
+        perror("Failed to write file!\n");
     }
 
+    free(buffer);
     fclose(file);
 }
 
-int createPerlinNoise(float cellSize, int width, int height, int seed) {
-    // Sets the seed, used in making a peusdo-random gradient to make it so that the result can be replicated.
-    
+#define PERLIN_TILE_SIZE 64 // 64 x 64 floats is 16KB, small enough for a tile to stay in the L1 cache while it is worked on
+
+// Fills a tile with either a single octave or, if fractal settings are given, layered fractal noise
+void noiseTile(float* out, int stride, int startX, int startY, int tileWidth, int tileHeight, float cellSize, int seed, GradientMode mode, const FractalSettings* fractal) {
+    if (fractal) {
+        fractalNoiseTile(out, stride, startX, startY, tileWidth, tileHeight, cellSize, seed, mode, *fractal);
+    }
+    else {
+        perlinNoiseTile(out, stride, startX, startY, tileWidth, tileHeight, cellSize, seed, mode);
+    }
+}
+
+// Turns a noise value from [-1, 1] into a height from 0 to 1
+float noiseToHeight(float noise) {
+    return (noise + 1.0f) * 0.5f;
+}
+
+// Heights from 0 to 1 stored as 8 and 16 bit integers
+uint8_t heightToByte(float height) {
+    return (uint8_t)(height * 255.0f); // Scaled to [0, 255]
+}
+
+uint16_t heightToUint16(float height) {
+    return (uint16_t)(height * 65535.0f); // Scaled to [0, 65535]
+}
+
+// Turns a noise value from [-1, 1] into a height from 0 to 255
+uint8_t noiseToByte(float noise) {
+    return heightToByte(noiseToHeight(noise));
+}
+
+/*
+Fills the width x height region of the image starting at pixel (originX, originY) with noise by splitting it into tiles
+and handing them to the pool's workers, if fractal is given each tile is layered with fractalNoiseTile instead of being a single octave.
+Each tile only depends on its own position, so the result is the same no matter how many workers there are or
+which worker ends up doing which tile. store is called by the worker with the finished tile so it can be written
+out to whatever format the caller wants.
+*/
+void perlinNoiseRegionParallel(int originX, int originY, int width, int height, float cellSize, int seed, GradientMode mode, ThreadPool& pool,
+                               const std::function<void(const float* tile, int startX, int startY, int tileWidth, int tileHeight)>& store,
+                               const FractalSettings* fractal = nullptr) {
+    int tilesX = (width + PERLIN_TILE_SIZE - 1) / PERLIN_TILE_SIZE;
+    int tilesY = (height + PERLIN_TILE_SIZE - 1) / PERLIN_TILE_SIZE;
+
+    pool.parallelFor(tilesX * tilesY, [&](int tile) {
+        float values[PERLIN_TILE_SIZE * PERLIN_TILE_SIZE];
+        int offsetX = (tile % tilesX) * PERLIN_TILE_SIZE;
+        int offsetY = (tile / tilesX) * PERLIN_TILE_SIZE;
+        int tileWidth = width - offsetX < PERLIN_TILE_SIZE ? width - offsetX : PERLIN_TILE_SIZE;
+        int tileHeight = height - offsetY < PERLIN_TILE_SIZE ? height - offsetY : PERLIN_TILE_SIZE;
+
+        noiseTile(values, PERLIN_TILE_SIZE, originX + offsetX, originY + offsetY, tileWidth, tileHeight, cellSize, seed, mode, fractal);
+        store(values, originX + offsetX, originY + offsetY, tileWidth, tileHeight);
+    });
+}
+
+// The same as perlinNoiseRegionParallel for a whole image starting at (0, 0)
+void perlinNoiseParallel(int width, int height, float cellSize, int seed, GradientMode mode, ThreadPool& pool,
+                         const std::function<void(const float* tile, int startX, int startY, int tileWidth, int tileHeight)>& store,
+                         const FractalSettings* fractal = nullptr) {
+    perlinNoiseRegionParallel(0, 0, width, height, cellSize, seed, mode, pool, store, fractal);
+}
+
+// A heightmap kept in memory, each pixel is a height from 0 to 1 kept at full float precision
+typedef struct {
+    int width;
+    int height;
+    std::vector<float> heights;
+} Heightmap;
+
+/*
+Creates the heightmap and returns it, if a pool is given the work is spread over its workers, otherwise it is all done on this thread.
+Passing fractal settings layers several octaves together instead of using a single one.
+If bmpPath is given the heightmap is also saved as an 8 bit bitmap, nothing needs to read it back as the returned heightmap already has the data.
+*/
+Heightmap createPerlinNoise(float cellSize, int width, int height, int seed, GradientMode mode = GRADIENT_ANGLE, ThreadPool* pool = nullptr,
+                            const FractalSettings* fractal = nullptr, const char* bmpPath = nullptr) {
+    Heightmap heightmap;
+    heightmap.width = width;
+    heightmap.height = height;
     // Allocates memory for each of the pixel noise values
-    int* values = (int*)malloc(sizeof(int) * width * height);
+    heightmap.heights.resize((size_t)width * height);
+    float* values = heightmap.heights.data();
 
-    // Fills values with the perlin noise values used in creating the image.
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            // Noise value is created so the value can be scaled to [0, 255]
-            float noise = perlinNoise(x / cellSize, y / cellSize, seed);
-            noise = (noise + 1.0f) * 0.5f * 255.0f; // Scaled to [0, 255]
-            values[y * width + x] = (int)noise;
+    if (pool) {
+        perlinNoiseParallel(width, height, cellSize, seed, mode, *pool, [&](const float* tile, int startX, int startY, int tileWidth, int tileHeight) {
+            for (int y = 0; y < tileHeight; y++) {
+                for (int x = 0; x < tileWidth; x++) {
+                    values[(startY + y) * width + startX + x] = noiseToHeight(tile[y * PERLIN_TILE_SIZE + x]);
+                }
+            }
+        }, fractal);
+    }
+    else {
+        // The image is made in bands of rows so the corner gradients of each lattice cell are only worked out once per band
+        const int bandHeight = 64;
+
+        // Fills values with the perlin noise values used in creating the image.
+        for (int bandY = 0; bandY < height; bandY += bandHeight) {
+            int rows = height - bandY < bandHeight ? height - bandY : bandHeight;
+            float* band = values + (size_t)bandY * width;
+            noiseTile(band, width, 0, bandY, width, rows, cellSize, seed, mode, fractal);
+            for (int i = 0; i < width * rows; i++) {
+                band[i] = noiseToHeight(band[i]);
+            }
         }
     }
 
-    // Creates a bitmap file for usage in other applications, in terms of this project; The 3D enviroment
-    writeBMP("perlin.bmp", values, width, height);
-    //I'd rather not have the program have a memory leak
-    free(values);
+    // Creates a bitmap file for usage in other applications, the 3D enviroment uses the returned heightmap directly
+    if (bmpPath) {
+        std::vector<uint8_t> pixels(heightmap.heights.size());
+        for (size_t i = 0; i < pixels.size(); i++) {
+            pixels[i] = heightToByte(values[i]);
+        }
+        writeBMP(bmpPath, pixels.data(), width, height, BMP_GRAYSCALE8);
+    }
+
+    return heightmap;
+}
 
-    return 0;
-}
\ No newline at end of file
+#endif
@@ -0,0 +1,113 @@
+#ifndef STD140_H
+#define STD140_H
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+/*
+Lays values out in memory the way a layout(std140) uniform block expects them, so a whole block can be filled on the CPU
+and sent with one buffer write. Values have to be written in the order the block declares them. The rules that matter:
+- float, int and bool take 4 bytes on a 4 byte boundary (a bool is stored as 0 or 1)
+- vec2 takes 8 bytes on an 8 byte boundary
+- vec3 takes 12 bytes on a 16 byte boundary, so a float declared after a vec3 fills the gap at the end of it
+- vec4 takes 16 bytes on a 16 byte boundary, a matN is N vec4 columns
+- every element of an array starts on a 16 byte boundary, even for floats
+- a struct starts and ends on a 16 byte boundary
+Each write returns the offset it was put at, which is what glGetActiveUniformsiv(GL_UNIFORM_OFFSET) reports for that member.
+*/
+class Std140Writer
+{
+public:
+    // Starts a block at the beginning of out, the vector keeps its capacity so packing every frame doesn't allocate
+    Std140Writer(std::vector<uint8_t>& out) : out(out) {
+        out.clear();
+    }
+
+    size_t write(float value) {
+        return place(&value, 4, 4);
+    }
+
+    size_t write(int value) {
+        return place(&value, 4, 4);
+    }
+
+    size_t write(uint32_t value) {
+        return place(&value, 4, 4);
+    }
+
+    size_t write(bool value) {
+        uint32_t stored = value ? 1 : 0;
+        return place(&stored, 4, 4);
+    }
+
+    size_t write(const glm::vec2& value) {
+        return place(&value[0], 8, 8);
+    }
+
+    size_t write(const glm::vec3& value) {
+        return place(&value[0], 12, 16);
+    }
+
+    size_t write(const glm::vec4& value) {
+        return place(&value[0], 16, 16);
+    }
+
+    size_t write(const glm::mat3& value) {
+        size_t offset = write(value[0]);
+        write(value[1]);
+        write(value[2]);
+        // The last column is padded out to a full vec4 like every column
+        align(16);
+        return offset;
+    }
+
+    size_t write(const glm::mat4& value) {
+        return place(&value[0][0], 64, 16);
+    }
+
+    // Every element of an array is padded out to 16 bytes
+    template <typename T>
+    size_t writeArray(const T* values, int count) {
+        size_t offset = align(16);
+        for (int i = 0; i < count; i++) {
+            align(16);
+            write(values[i]);
+        }
+        align(16);
+        return offset;
+    }
+
+    // Call around the members of a struct, including each struct in an array of them
+    size_t beginStruct() {
+        return align(16);
+    }
+
+    void endStruct() {
+        align(16);
+    }
+
+    // Pads with zeros up to the next multiple of alignment and returns the new size
+    size_t align(size_t alignment) {
+        size_t size = (out.size() + alignment - 1) / alignment * alignment;
+        out.resize(size, 0);
+        return size;
+    }
+
+    size_t size() const {
+        return out.size();
+    }
+
+private:
+    std::vector<uint8_t>& out;
+
+    size_t place(const void* data, size_t size, size_t alignment) {
+        size_t offset = align(alignment);
+        out.resize(offset + size);
+        memcpy(out.data() + offset, data, size);
+        return offset;
+    }
+};
+
+#endif
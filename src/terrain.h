@@ -0,0 +1,99 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <memory>
+#include <vector>
+#include "perlin.h"
+#include "heightmapIO.h"
+#include "world.h"
+#include "mesher.h"
+
+/*
+The noise rounds positions towards zero, which only works for positions that aren't negative, so the terrain is moved
+this far into the noise. That leaves over a million blocks in every direction before the noise would go wrong.
+*/
+#define TERRAIN_NOISE_OFFSET (1 << 20)
+
+// Everything needed to work out the terrain at any position, two chunks made with the same settings always match up
+struct TerrainSettings
+{
+    int seed;
+    int maxHeight;   // Height of the tallest possible column, the noise is scaled from [0, 1] to this
+    float cellSize;  // Size of one cell of the perlin noise lattice in blocks
+    // Heights from 0 to 1 covering the columns from (0, 0), the noise carries on past its edges. Shared as it is read-only
+    std::shared_ptr<const Heightmap> heightmap;
+};
+
+TerrainSettings createTerrainSettings(int seed, int maxHeight, float cellSize = 64.0f) {
+    TerrainSettings settings;
+    settings.seed = seed;
+    settings.maxHeight = maxHeight < CHUNK_HEIGHT ? maxHeight : CHUNK_HEIGHT;
+    settings.cellSize = cellSize;
+    return settings;
+}
+
+/*
+Builds the terrain from a heightmap saved by HeightFileSink, in any of its formats. The map covers the columns from (0, 0)
+the same way the export does, so loading a float heightmap saved from a seed gives back exactly that seed's terrain.
+Returns false and leaves the settings alone if the file can't be read.
+*/
+bool loadTerrainHeightmap(const char* filename, TerrainSettings& settings) {
+    std::shared_ptr<Heightmap> heightmap = std::make_shared<Heightmap>();
+    if (!readHeightFile(filename, *heightmap)) {
+        return false;
+    }
+    settings.heightmap = heightmap;
+    return true;
+}
+
+/*
+Fills the columns from (startX, startZ) up to but not including (endX, endZ) inside the chunk. The noise only depends on
+the world position of each column, so a chunk can be built on its own without anything around it existing yet.
+*/
+void generateChunkColumns(Chunk& chunk, const TerrainSettings& settings, int startX, int startZ, int endX, int endZ) {
+    float heights[CHUNK_SIZE * CHUNK_SIZE];
+    int width = endX - startX;
+    int depth = endZ - startZ;
+    int noiseX = chunk.coord.x * CHUNK_SIZE + startX + TERRAIN_NOISE_OFFSET;
+    int noiseZ = chunk.coord.z * CHUNK_SIZE + startZ + TERRAIN_NOISE_OFFSET;
+    noiseTile(heights, width, noiseX, noiseZ, width, depth, settings.cellSize, settings.seed, GRADIENT_ANGLE, nullptr);
+    const Heightmap* map = settings.heightmap.get();
+    for (int z = 0; z < depth; z++) {
+        for (int x = 0; x < width; x++) {
+            float height = noiseToHeight(heights[z * width + x]);
+            int mapX = chunk.coord.x * CHUNK_SIZE + startX + x;
+            int mapZ = chunk.coord.z * CHUNK_SIZE + startZ + z;
+            if (map && mapX >= 0 && mapZ >= 0 && mapX < map->width && mapZ < map->height) {
+                height = map->heights[(size_t)mapZ * map->width + mapX];
+            }
+            int columnHeight = (int)(height * settings.maxHeight);
+            columnHeight = columnHeight < CHUNK_HEIGHT ? columnHeight : CHUNK_HEIGHT;
+            for (int y = 0; y < columnHeight; y++) {
+                chunk.set(startX + x, y, startZ + z, y < 4 ? BLOCK_STONE : BLOCK_DIRT);
+            }
+        }
+    }
+}
+
+std::unique_ptr<Chunk> generateChunk(ChunkCoord coord, const TerrainSettings& settings) {
+    std::unique_ptr<Chunk> chunk = std::make_unique<Chunk>(coord);
+    generateChunkColumns(*chunk, settings, 0, 0, CHUNK_SIZE, CHUNK_SIZE);
+    return chunk;
+}
+
+/*
+Meshes a freshly generated chunk without needing the world, so it can be done on a worker thread while the world is in use.
+The mesher only looks one block past the chunk's sides, so just that row of columns is generated for each neighbour.
+The mesh comes out the same as meshing the chunk inside a world where all of its neighbours are loaded.
+*/
+MeshStats meshGeneratedChunk(const Chunk& chunk, const TerrainSettings& settings, MeshMode mode, std::vector<PackedVertex>& out) {
+    VoxelWorld edges;
+    ChunkCoord coord = chunk.coord;
+    generateChunkColumns(*edges.createChunk({ coord.x - 1, coord.z }), settings, CHUNK_SIZE - 1, 0, CHUNK_SIZE, CHUNK_SIZE);
+    generateChunkColumns(*edges.createChunk({ coord.x + 1, coord.z }), settings, 0, 0, 1, CHUNK_SIZE);
+    generateChunkColumns(*edges.createChunk({ coord.x, coord.z - 1 }), settings, 0, CHUNK_SIZE - 1, CHUNK_SIZE, CHUNK_SIZE);
+    generateChunkColumns(*edges.createChunk({ coord.x, coord.z + 1 }), settings, 0, 0, CHUNK_SIZE, 1);
+    return meshChunk(edges, chunk, out, mode);
+}
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+A work-stealing thread pool. Each worker has its own queue of tasks which it takes from the back of, when it runs out
+it steals from the front of the other workers' queues so that no worker sits idle while there is still work left.
+*/
+class ThreadPool
+{
+public:
+    // A workerCount of 0 or less uses one worker per hardware thread
+    ThreadPool(int workerCount = 0) {
+        if (workerCount <= 0) {
+            workerCount = (int)std::thread::hardware_concurrency();
+        }
+        if (workerCount <= 0) {
+            workerCount = 1;
+        }
+        for (int i = 0; i < workerCount; i++) {
+            queues.push_back(std::make_unique<WorkerQueue>());
+        }
+        for (int i = 0; i < workerCount; i++) {
+            workers.emplace_back(&ThreadPool::workerLoop, this, i);
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepLock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int workerCount() const {
+        return (int)workers.size();
+    }
+
+    // Queues a task to be run on one of the workers, tasks are spread over the workers' queues in turn
+    void submit(std::function<void()> task) {
+        // Unsigned so the counter wraps back to 0 after 2^32 submits instead of going negative
+        size_t index = nextQueue.fetch_add(1, std::memory_order_relaxed) % (unsigned)queues.size();
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->lock);
+            queues[index]->tasks.push_back(std::move(task));
+        }
+        {
+            // Taken so a worker can't miss the wake up between checking queuedTasks and going to sleep
+            std::lock_guard<std::mutex> lock(sleepLock);
+            queuedTasks++;
+        }
+        wake.notify_one();
+    }
+
+    // Runs task(i) for every i in [0, taskCount) on the workers and waits until all of them have finished.
+    // This blocks the calling thread, so it must not be called from inside a task running on this pool.
+    void parallelFor(int taskCount, const std::function<void(int)>& task) {
+        if (taskCount <= 0) {
+            return;
+        }
+        std::mutex doneLock;
+        std::condition_variable done;
+        int remaining = taskCount;
+
+        for (int i = 0; i < taskCount; i++) {
+            submit([&, i]() {
+                task(i);
+                std::lock_guard<std::mutex> lock(doneLock);
+                if (--remaining == 0) {
+                    done.notify_all();
+                }
+            });
+        }
+
+        std::unique_lock<std::mutex> lock(doneLock);
+        done.wait(lock, [&]() { return remaining == 0; });
+    }
+
+private:
+    struct WorkerQueue {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<unsigned> nextQueue{0};
+
+    std::mutex sleepLock;
+    std::condition_variable wake;
+    int queuedTasks = 0;
+    bool stopping = false;
+
+    // Takes the newest task from a worker's own queue, this is the one most likely to still be in its cache
+    bool popLocal(int index, std::function<void()>& task) {
+        WorkerQueue& queue = *queues[index];
+        std::lock_guard<std::mutex> lock(queue.lock);
+        if (queue.tasks.empty()) {
+            return false;
+        }
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    // Takes the oldest task from another worker's queue
+    bool steal(int index, std::function<void()>& task) {
+        int count = (int)queues.size();
+        for (int offset = 1; offset < count; offset++) {
+            WorkerQueue& queue = *queues[(index + offset) % count];
+            std::lock_guard<std::mutex> lock(queue.lock);
+            if (!queue.tasks.empty()) {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(int index) {
+        while (true) {
+            std::function<void()> task;
+            if (popLocal(index, task) || steal(index, task)) {
+                {
+                    std::lock_guard<std::mutex> lock(sleepLock);
+                    queuedTasks--;
+                }
+                task();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepLock);
+            wake.wait(lock, [this]() { return stopping || queuedTasks > 0; });
+            if (stopping && queuedTasks == 0) {
+                return;
+            }
+        }
+    }
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "shader.h"
+#include "frameUniforms.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -7,7 +8,8 @@
 float timeElapsed = 0.0f;
 glm::vec3 ambientLighting;
 
-void dayCycle(float deltaTime, Shader lightingShader) {
+// Moves the sun across the sky and works out how bright it is, the result goes in the frame's uniform block
+void dayCycle(float deltaTime, DirectionalLight& sun) {
     timeElapsed += deltaTime;
 
     // Day cycle configuration
@@ -35,8 +37,8 @@ void dayCycle(float deltaTime, Shader lightingShader) {
 
     ambientLighting = glm::vec3(lightIntensity, lightIntensity, lightIntensity);
 
-    lightingShader.setVec3("dirLight.direction", lightDirection);
-    lightingShader.setVec3("dirLight.ambient", ambientLighting);
-    lightingShader.setVec3("dirLight.diffuse", glm::vec3(lightIntensity * 0.5f));
-    lightingShader.setVec3("dirLight.specular", glm::vec3(lightIntensity * 0.2f));
+    sun.direction = lightDirection;
+    sun.ambient = ambientLighting;
+    sun.diffuse = glm::vec3(lightIntensity * 0.5f);
+    sun.specular = glm::vec3(lightIntensity * 0.2f);
 }
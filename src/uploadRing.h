@@ -0,0 +1,187 @@
+#ifndef UPLOADRING_H
+#define UPLOADRING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+
+// A GPU fence, a GLsync for the OpenGL backends. nullptr means nothing has been fenced.
+typedef void* UploadFence;
+
+/*
+What the upload ring needs from the graphics API. The ring itself only does the bookkeeping, so it can be driven by a
+mock backend without a window. glUploadBackends.h has the OpenGL ones.
+*/
+class UploadBackend
+{
+public:
+    virtual ~UploadBackend() {}
+    // Replaces the buffer with a new one of size bytes and returns where the CPU writes to it, or nullptr if it failed
+    virtual uint8_t* allocate(size_t size) = 0;
+    // Makes the bytes written between offset and offset + size visible to the GPU
+    virtual void flush(size_t offset, size_t size) = 0;
+    // Puts a fence after every command sent so far
+    virtual UploadFence insertFence() = 0;
+    // Waits up to timeout nanoseconds for the GPU to pass the fence, 0 just checks. Returns true once it has.
+    virtual bool waitFence(UploadFence fence, uint64_t timeout) = 0;
+    virtual void deleteFence(UploadFence fence) = 0;
+    // The buffer's name in the graphics API, changes whenever allocate is called
+    virtual unsigned int buffer() const = 0;
+};
+
+// Counts kept by the ring, mostly to see how often it had to wait for the GPU
+struct UploadRingStats
+{
+    size_t writes;
+    size_t bytesWritten;
+    size_t fenceWaits;  // Writes that found the GPU still reading the section and had to wait for it
+    size_t grows;       // Times the buffer was too small and had to be made again
+};
+
+/*
+One buffer split into sectionCount equal sections that are written in turn. Each write goes into the section after the
+one written last while the GPU carries on reading the last one, and a section is only written again once the fence put
+down after the draws that read it has passed. With three sections the CPU is normally two uploads ahead of anything the
+GPU could still be using, so writing costs a memcpy and never waits or reallocates.
+
+The buffer stays mapped for its whole life. It is only made again if a write is bigger than a section, which waits for
+the GPU to finish with every section first and then doubles the section size until the write fits.
+*/
+class UploadRing
+{
+public:
+    UploadRing(UploadBackend& backend, size_t sectionSize, int sectionCount = 3) : backend(backend), sectionSize(sectionSize) {
+        sections.resize(sectionCount < 1 ? 1 : sectionCount);
+        allocateSections();
+    }
+
+    ~UploadRing() {
+        for (Section& section : sections) {
+            if (section.fence) {
+                backend.deleteFence(section.fence);
+            }
+        }
+    }
+
+    UploadRing(const UploadRing&) = delete;
+    UploadRing& operator=(const UploadRing&) = delete;
+
+    /*
+    Returns space for size bytes the GPU is no longer reading, finish the write with endWrite.
+    Returns nullptr if the backend couldn't make a big enough buffer.
+    */
+    uint8_t* beginWrite(size_t size) {
+        if (size > sectionSize) {
+            grow(size);
+        }
+        if (!mapped) {
+            return nullptr;
+        }
+        writing = (current + 1) % (int)sections.size();
+        Section& section = sections[writing];
+        if (section.fence) {
+            if (!backend.waitFence(section.fence, 0)) {
+                stats.fenceWaits++;
+                while (!backend.waitFence(section.fence, FENCE_TIMEOUT)) {}
+            }
+            backend.deleteFence(section.fence);
+            section.fence = nullptr;
+        }
+        writeSize = size;
+        return mapped + sectionOffset(writing);
+    }
+
+    // Hands the written bytes to the GPU and makes them the newest data, returns where they start in the buffer
+    size_t endWrite() {
+        size_t offset = sectionOffset(writing);
+        backend.flush(offset, writeSize);
+        current = writing;
+        stats.writes++;
+        stats.bytesWritten += writeSize;
+        return offset;
+    }
+
+    // Copies size bytes in and returns where they start in the buffer, or (size_t)-1 if there was no room
+    size_t write(const void* data, size_t size) {
+        uint8_t* destination = beginWrite(size);
+        if (!destination) {
+            return (size_t)-1;
+        }
+        if (size > 0) {
+            memcpy(destination, data, size);
+        }
+        return endWrite();
+    }
+
+    // Called after the draws that read the newest data, so its section isn't written over while they are still running
+    void fenceReads() {
+        Section& section = sections[current];
+        if (section.fence) {
+            backend.deleteFence(section.fence);
+        }
+        section.fence = backend.insertFence();
+    }
+
+    unsigned int buffer() const {
+        return backend.buffer();
+    }
+
+    size_t capacity() const {
+        return sectionSize * sections.size();
+    }
+
+    // Changes every time the buffer is made again, anything pointing at the old buffer has to be pointed at the new one
+    int bufferGeneration() const {
+        return generation;
+    }
+
+    UploadRingStats stats = { 0, 0, 0, 0 };
+
+private:
+    struct Section {
+        UploadFence fence = nullptr;
+    };
+
+    // How long each wait for the GPU is before checking again, in nanoseconds
+    static const uint64_t FENCE_TIMEOUT = 1000000;
+
+    UploadBackend& backend;
+    std::vector<Section> sections;
+    size_t sectionSize;
+    uint8_t* mapped = nullptr;
+    int current = 0;
+    int writing = 0;
+    size_t writeSize = 0;
+    int generation = 0;
+
+    size_t sectionOffset(int index) const {
+        return sectionSize * index;
+    }
+
+    void allocateSections() {
+        mapped = backend.allocate(sectionSize * sections.size());
+        generation++;
+    }
+
+    void grow(size_t size) {
+        // The old buffer can only go once nothing is reading any of it
+        for (Section& section : sections) {
+            if (section.fence) {
+                while (!backend.waitFence(section.fence, FENCE_TIMEOUT)) {}
+                backend.deleteFence(section.fence);
+                section.fence = nullptr;
+            }
+        }
+        if (sectionSize == 0) {
+            sectionSize = 1;
+        }
+        while (sectionSize < size) {
+            sectionSize *= 2;
+        }
+        allocateSections();
+        stats.grows++;
+    }
+};
+
+#endif
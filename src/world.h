@@ -0,0 +1,309 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <memory>
+#include <unordered_map>
+
+// Every chunk is a CHUNK_SIZE x CHUNK_HEIGHT x CHUNK_SIZE column of blocks
+#define CHUNK_SIZE 16
+#define CHUNK_HEIGHT 64
+
+// The type of a single block, stored as one byte so a whole chunk is only 16KB
+enum BlockID : uint8_t
+{
+    BLOCK_AIR,
+    BLOCK_DIRT,
+    BLOCK_GRASS,
+    BLOCK_STONE
+};
+
+// Which chunk a block is in, chunks are only split along x and z
+struct ChunkCoord
+{
+    int x;
+    int z;
+
+    bool operator==(const ChunkCoord& other) const {
+        return x == other.x && z == other.z;
+    }
+};
+
+struct ChunkCoordHash
+{
+    size_t operator()(const ChunkCoord& coord) const {
+        // Packs both coordinates into one 64 bit number so neighbouring chunks don't share a hash
+        return std::hash<uint64_t>()(((uint64_t)(uint32_t)coord.x << 32) | (uint32_t)coord.z);
+    }
+};
+
+// Divides and rounds down rather than towards zero, so block -1 is in chunk -1 and not chunk 0
+inline int floorDiv(int value, int divisor) {
+    return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+inline int floorMod(int value, int divisor) {
+    return value - floorDiv(value, divisor) * divisor;
+}
+
+class Chunk
+{
+public:
+    ChunkCoord coord;
+    uint8_t blocks[CHUNK_SIZE * CHUNK_HEIGHT * CHUNK_SIZE];
+
+    Chunk(ChunkCoord coord) : coord(coord) {
+        memset(blocks, BLOCK_AIR, sizeof(blocks));
+    }
+
+    // Blocks are stored in layers of y so a column's blocks are CHUNK_SIZE * CHUNK_SIZE apart and a layer is contiguous
+    static int index(int x, int y, int z) {
+        return (y * CHUNK_SIZE + z) * CHUNK_SIZE + x;
+    }
+
+    BlockID get(int x, int y, int z) const {
+        return (BlockID)blocks[index(x, y, z)];
+    }
+
+    void set(int x, int y, int z, BlockID block) {
+        blocks[index(x, y, z)] = block;
+    }
+};
+
+/*
+The blocks that make up the world, stored as dense chunks of block IDs looked up through a hash map.
+Finding the block at any world position is one hash lookup and one array index no matter how big the world is.
+*/
+class VoxelWorld
+{
+public:
+    // Returns the chunk at the coordinate, or nullptr if nothing has been placed in it
+    Chunk* getChunk(ChunkCoord coord) {
+        auto it = chunks.find(coord);
+        return it == chunks.end() ? nullptr : it->second.get();
+    }
+
+    const Chunk* getChunk(ChunkCoord coord) const {
+        auto it = chunks.find(coord);
+        return it == chunks.end() ? nullptr : it->second.get();
+    }
+
+    // Returns the chunk at the coordinate, creating an empty one if needed
+    Chunk* createChunk(ChunkCoord coord) {
+        std::unique_ptr<Chunk>& chunk = chunks[coord];
+        if (!chunk) {
+            chunk = std::make_unique<Chunk>(coord);
+        }
+        return chunk.get();
+    }
+
+    // Adds a chunk that was built somewhere else, replacing any chunk already at its coordinate
+    void insertChunk(std::unique_ptr<Chunk> chunk) {
+        ChunkCoord coord = chunk->coord;
+        chunks[coord] = std::move(chunk);
+    }
+
+    // Takes a chunk out of the world, returning it so the caller decides when its memory is freed
+    std::unique_ptr<Chunk> removeChunk(ChunkCoord coord) {
+        auto it = chunks.find(coord);
+        if (it == chunks.end()) {
+            return nullptr;
+        }
+        std::unique_ptr<Chunk> chunk = std::move(it->second);
+        chunks.erase(it);
+        return chunk;
+    }
+
+    static ChunkCoord chunkCoordOf(int x, int z) {
+        return { floorDiv(x, CHUNK_SIZE), floorDiv(z, CHUNK_SIZE) };
+    }
+
+    // Anything outside the loaded chunks or above/below the world counts as air
+    BlockID getBlock(int x, int y, int z) const {
+        if (y < 0 || y >= CHUNK_HEIGHT) {
+            return BLOCK_AIR;
+        }
+        const Chunk* chunk = getChunk(chunkCoordOf(x, z));
+        if (!chunk) {
+            return BLOCK_AIR;
+        }
+        return chunk->get(floorMod(x, CHUNK_SIZE), y, floorMod(z, CHUNK_SIZE));
+    }
+
+    bool isSolid(int x, int y, int z) const {
+        return getBlock(x, y, z) != BLOCK_AIR;
+    }
+
+    void setBlock(int x, int y, int z, BlockID block) {
+        if (y < 0 || y >= CHUNK_HEIGHT) {
+            return;
+        }
+        ChunkCoord coord = chunkCoordOf(x, z);
+        Chunk* chunk = block == BLOCK_AIR ? getChunk(coord) : createChunk(coord);
+        if (chunk) {
+            chunk->set(floorMod(x, CHUNK_SIZE), y, floorMod(z, CHUNK_SIZE), block);
+        }
+    }
+
+    // Calls func(x, y, z, block) with the world position of every block that isn't air
+    template <typename Func>
+    void forEachBlock(Func func) const {
+        for (const auto& entry : chunks) {
+            const Chunk& chunk = *entry.second;
+            int baseX = chunk.coord.x * CHUNK_SIZE;
+            int baseZ = chunk.coord.z * CHUNK_SIZE;
+            for (int y = 0; y < CHUNK_HEIGHT; y++) {
+                for (int z = 0; z < CHUNK_SIZE; z++) {
+                    for (int x = 0; x < CHUNK_SIZE; x++) {
+                        BlockID block = chunk.get(x, y, z);
+                        if (block != BLOCK_AIR) {
+                            func(baseX + x, y, baseZ + z, block);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Calls func(chunk) for every chunk that has been created
+    template <typename Func>
+    void forEachChunk(Func func) const {
+        for (const auto& entry : chunks) {
+            func(*entry.second);
+        }
+    }
+
+    /*
+    Calls func(x, y, z, block) for every block that has at least one face touching air, the rest are completely
+    surrounded and can never be seen. Nothing can be seen from below the world so it counts as solid here.
+    Every block gets looked at on the way, so it returns how many blocks there are, seen or not.
+    */
+    template <typename Func>
+    size_t forEachExposedBlock(Func func) const {
+        size_t count = 0;
+        for (const auto& entry : chunks) {
+            const Chunk& chunk = *entry.second;
+            int baseX = chunk.coord.x * CHUNK_SIZE;
+            int baseZ = chunk.coord.z * CHUNK_SIZE;
+            // Neighbours inside the chunk are read straight from it, only the ones across an edge need a lookup
+            auto solidAt = [&](int x, int y, int z) {
+                if (y < 0) {
+                    return true;
+                }
+                if (x >= 0 && x < CHUNK_SIZE && z >= 0 && z < CHUNK_SIZE && y < CHUNK_HEIGHT) {
+                    return chunk.get(x, y, z) != BLOCK_AIR;
+                }
+                return isSolid(baseX + x, y, baseZ + z);
+            };
+            for (int y = 0; y < CHUNK_HEIGHT; y++) {
+                for (int z = 0; z < CHUNK_SIZE; z++) {
+                    for (int x = 0; x < CHUNK_SIZE; x++) {
+                        BlockID block = chunk.get(x, y, z);
+                        if (block == BLOCK_AIR) {
+                            continue;
+                        }
+                        count++;
+                        if (!solidAt(x - 1, y, z) || !solidAt(x + 1, y, z) ||
+                            !solidAt(x, y - 1, z) || !solidAt(x, y + 1, z) ||
+                            !solidAt(x, y, z - 1) || !solidAt(x, y, z + 1)) {
+                            func(baseX + x, y, baseZ + z, block);
+                        }
+                    }
+                }
+            }
+        }
+        return count;
+    }
+
+    size_t blockCount() const {
+        size_t count = 0;
+        forEachBlock([&](int, int, int, BlockID) { count++; });
+        return count;
+    }
+
+    size_t chunkCount() const {
+        return chunks.size();
+    }
+
+    void clear() {
+        chunks.clear();
+    }
+
+    // Trades chunks with another world, nothing is copied so this is instant however big either world is
+    void swap(VoxelWorld& other) {
+        chunks.swap(other.chunks);
+    }
+
+private:
+    std::unordered_map<ChunkCoord, std::unique_ptr<Chunk>, ChunkCoordHash> chunks;
+};
+
+// What a ray ran into: the block, the side of it the ray came in through and how far along the ray that was
+struct RaycastHit
+{
+    int block[3];
+    int normal[3];   // Points out of the face that was hit, all zero if the ray started inside the block
+    float distance;
+    BlockID type;
+};
+
+/*
+Walks a ray through the world one cell at a time (Amanatides and Woo's DDA) and stops at the first solid block, only the
+cells the ray actually passes through are looked at. direction doesn't have to be normalised, distances are in blocks.
+Blocks are centred on whole numbers so cell n covers n - 0.5 to n + 0.5 on each axis.
+*/
+inline bool raycastWorld(const VoxelWorld& world, const float origin[3], const float direction[3], float maxDistance, RaycastHit& hit) {
+    float length = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+    if (length == 0.0f) {
+        return false;
+    }
+    int cell[3];
+    int step[3];
+    float tMax[3];   // How far along the ray the next cell boundary is on each axis
+    float tDelta[3]; // How far along the ray it is from one boundary to the next on each axis
+    for (int i = 0; i < 3; i++) {
+        float d = direction[i] / length;
+        float p = origin[i] + 0.5f;
+        cell[i] = (int)floorf(p);
+        if (d > 0.0f) {
+            step[i] = 1;
+            tDelta[i] = 1.0f / d;
+            tMax[i] = (cell[i] + 1 - p) * tDelta[i];
+        }
+        else if (d < 0.0f) {
+            step[i] = -1;
+            tDelta[i] = -1.0f / d;
+            tMax[i] = (p - cell[i]) * tDelta[i];
+        }
+        else {
+            step[i] = 0;
+            tDelta[i] = INFINITY;
+            tMax[i] = INFINITY;
+        }
+        hit.normal[i] = 0;
+    }
+
+    float distance = 0.0f;
+    while (true) {
+        BlockID type = world.getBlock(cell[0], cell[1], cell[2]);
+        if (type != BLOCK_AIR) {
+            memcpy(hit.block, cell, sizeof(cell));
+            hit.distance = distance;
+            hit.type = type;
+            return true;
+        }
+        int axis = tMax[0] < tMax[1] ? (tMax[0] < tMax[2] ? 0 : 2) : (tMax[1] < tMax[2] ? 1 : 2);
+        distance = tMax[axis];
+        if (distance > maxDistance) {
+            return false;
+        }
+        cell[axis] += step[axis];
+        tMax[axis] += tDelta[axis];
+        hit.normal[0] = hit.normal[1] = hit.normal[2] = 0;
+        hit.normal[axis] = -step[axis];
+    }
+}
+
+#endif
@@ -0,0 +1,122 @@
+#include "terrain.h"
+#include "test.h"
+
+const char* testFile = "heightmapIO_test.hmap";
+const int mapSize = 96;
+const int seed = 4321;
+
+// The heights the export writes, made one pixel at a time straight from the noise
+std::vector<float> expectedHeights() {
+    std::vector<float> heights((size_t)mapSize * mapSize);
+    for (int y = 0; y < mapSize; y++) {
+        for (int x = 0; x < mapSize; x++) {
+            float n = perlinNoise((float)(TERRAIN_NOISE_OFFSET + x) / 64.0f, (float)(TERRAIN_NOISE_OFFSET + y) / 64.0f, seed, GRADIENT_ANGLE);
+            heights[(size_t)y * mapSize + x] = noiseToHeight(n);
+        }
+    }
+    return heights;
+}
+
+bool exportHeights(HeightFormat format) {
+    HeightFileSink sink(testFile, format);
+    return streamPerlinNoise(sink, 64, TERRAIN_NOISE_OFFSET, TERRAIN_NOISE_OFFSET, mapSize, mapSize, seed);
+}
+
+// A float file has to come back bit for bit, and the terrain built from it has to be the seed's own terrain
+void testFloatRoundTrip() {
+    std::vector<float> expected = expectedHeights();
+    CHECK(exportHeights(HEIGHT_FLOAT32));
+
+    Heightmap heightmap;
+    CHECK(readHeightFile(testFile, heightmap));
+    CHECK_EQUAL(heightmap.width, mapSize);
+    CHECK_EQUAL(heightmap.height, mapSize);
+    CHECK(heightmap.heights.size() == expected.size() && memcmp(heightmap.heights.data(), expected.data(), sizeof(float) * expected.size()) == 0);
+
+    TerrainSettings generated = createTerrainSettings(seed, 64);
+    TerrainSettings loaded = generated;
+    CHECK(loadTerrainHeightmap(testFile, loaded));
+    for (int z = 0; z < mapSize / CHUNK_SIZE; z++) {
+        for (int x = 0; x < mapSize / CHUNK_SIZE; x++) {
+            std::unique_ptr<Chunk> a = generateChunk({ x, z }, generated);
+            std::unique_ptr<Chunk> b = generateChunk({ x, z }, loaded);
+            CHECK(memcmp(a->blocks, b->blocks, sizeof(a->blocks)) == 0);
+        }
+    }
+}
+
+// 16 bit heights lose everything below one step of 65535 and nothing more
+void testUint16RoundTrip() {
+    std::vector<float> expected = expectedHeights();
+    CHECK(exportHeights(HEIGHT_UINT16));
+
+    Heightmap heightmap;
+    CHECK(readHeightFile(testFile, heightmap));
+    CHECK_EQUAL(heightmap.width, mapSize);
+    CHECK_EQUAL(heightmap.height, mapSize);
+    CHECK(heightmap.heights.size() == expected.size());
+    for (size_t i = 0; i < expected.size() && i < heightmap.heights.size(); i++) {
+        CHECK(heightmap.heights[i] == heightToUint16(expected[i]) / 65535.0f);
+    }
+}
+
+void writeBytes(const std::vector<uint8_t>& bytes) {
+    FILE* file = fopen(testFile, "wb");
+    fwrite(bytes.data(), 1, bytes.size(), file);
+    fclose(file);
+}
+
+/*
+A file cut short, one with bytes left over, one whose header claims a size it doesn't hold, one with the wrong magic and
+one that isn't there all fail to load and leave the settings alone
+*/
+void testBadFiles() {
+    CHECK(exportHeights(HEIGHT_FLOAT32));
+    FILE* file = fopen(testFile, "rb");
+    std::vector<uint8_t> bytes(HEIGHT_FILE_HEADER_SIZE + (size_t)mapSize * mapSize * 4);
+    CHECK(fread(bytes.data(), 1, bytes.size(), file) == bytes.size());
+    fclose(file);
+    // The header is little endian whatever the machine, the width comes after the magic and version
+    CHECK(memcmp(bytes.data(), "HMAP", 4) == 0);
+    CHECK(bytes[8] == mapSize && bytes[9] == 0 && bytes[10] == 0 && bytes[11] == 0);
+
+    Heightmap heightmap;
+    writeBytes(std::vector<uint8_t>(bytes.begin(), bytes.end() - 1));
+    CHECK(!readHeightFile(testFile, heightmap));
+    writeBytes(std::vector<uint8_t>(bytes.begin(), bytes.begin() + HEIGHT_FILE_HEADER_SIZE - 1));
+    CHECK(!readHeightFile(testFile, heightmap));
+    std::vector<uint8_t> longer = bytes;
+    longer.push_back(0);
+    writeBytes(longer);
+    CHECK(!readHeightFile(testFile, heightmap));
+
+    for (uint32_t width : { 0u, (uint32_t)MAX_HEIGHT_FILE_SIDE + 1, 0xFFFFFFFFu }) {
+        std::vector<uint8_t> broken = bytes;
+        for (int b = 0; b < 4; b++) {
+            broken[8 + b] = (uint8_t)(width >> (b * 8));
+        }
+        writeBytes(broken);
+        CHECK(!readHeightFile(testFile, heightmap));
+    }
+    std::vector<uint8_t> tooTall = bytes;
+    tooTall[12] = (uint8_t)(mapSize + 1);
+    writeBytes(tooTall);
+    CHECK(!readHeightFile(testFile, heightmap));
+
+    bytes[0] = 'X';
+    writeBytes(bytes);
+    CHECK(!readHeightFile(testFile, heightmap));
+    TerrainSettings settings = createTerrainSettings(seed, 64);
+    CHECK(!loadTerrainHeightmap(testFile, settings));
+    CHECK(settings.heightmap == nullptr);
+
+    remove(testFile);
+    CHECK(!readHeightFile(testFile, heightmap));
+}
+
+int main() {
+    testFloatRoundTrip();
+    testUint16RoundTrip();
+    testBadFiles();
+    return finishTests("heightmapIO_test");
+}
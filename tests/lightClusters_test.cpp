@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <shader.h>
+#include "lightClusters.h"
+#include "test.h"
+
+// Lights scattered in front of and around a camera, with a mix of sizes and a few removed (radius 0)
+struct LightSet
+{
+    std::vector<glm::vec3> positions;
+    std::vector<float> radii;
+};
+
+LightSet makeLights(int count) {
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> across(-60.0f, 60.0f);
+    std::uniform_real_distribution<float> up(0.0f, 24.0f);
+    std::uniform_real_distribution<float> size(0.5f, 12.0f);
+    LightSet lights;
+    for (int i = 0; i < count; i++) {
+        lights.positions.push_back(glm::vec3(across(random), up(random), across(random)));
+        lights.radii.push_back(i % 50 == 0 ? 0.0f : size(random));
+    }
+    return lights;
+}
+
+/*
+Tests every light against every cluster with nothing skipped, what build() has to match. The lights of each cluster are
+in index order, the same as build() gives them.
+*/
+std::vector<std::vector<uint32_t>> bruteForceClusters(const LightClusters& clusters, const glm::mat4& view, const LightSet& lights) {
+    const ClusterBounds& bounds = clusters.clusterBounds();
+    std::vector<std::vector<uint32_t>> found(CLUSTER_COUNT);
+    for (size_t light = 0; light < lights.positions.size(); light++) {
+        float radius = lights.radii[light];
+        if (radius <= 0.0f) {
+            continue;
+        }
+        glm::vec3 centre = glm::vec3(view * glm::vec4(lights.positions[light], 1.0f));
+        for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+            float dx = fmaxf(fmaxf(bounds.minX[cluster] - centre.x, centre.x - bounds.maxX[cluster]), 0.0f);
+            float dy = fmaxf(fmaxf(bounds.minY[cluster] - centre.y, centre.y - bounds.maxY[cluster]), 0.0f);
+            float dz = fmaxf(fmaxf(bounds.minZ[cluster] - centre.z, centre.z - bounds.maxZ[cluster]), 0.0f);
+            if (dx * dx + dy * dy + dz * dz <= radius * radius) {
+                found[cluster].push_back((uint32_t)light);
+            }
+        }
+    }
+    return found;
+}
+
+// Counts the lights build() put in clusters they don't reach (extra) and left out of clusters they do reach (missing)
+void compareWithBruteForce(LightClusterKernel kernel, const LightSet& lights, const glm::mat4& view, size_t& missing, size_t& extra) {
+    LightClusterKernel previous = lightClusterKernel;
+    lightClusterKernel = kernel;
+    LightClusters clusters;
+    clusters.setProjection(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 500.0f);
+    clusters.build(view, lights.positions.data(), lights.radii.data(), (int)lights.positions.size());
+    lightClusterKernel = previous;
+
+    std::vector<std::vector<uint32_t>> expected = bruteForceClusters(clusters, view, lights);
+    missing = 0;
+    extra = 0;
+    for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+        uint32_t start = clusters.grid()[cluster * 2];
+        uint32_t count = clusters.grid()[cluster * 2 + 1];
+        std::vector<uint32_t> built(clusters.indices().begin() + start, clusters.indices().begin() + start + count);
+        const std::vector<uint32_t>& wanted = expected[cluster];
+        for (uint32_t light : wanted) {
+            missing += std::find(built.begin(), built.end(), light) == built.end();
+        }
+        for (uint32_t light : built) {
+            extra += std::find(wanted.begin(), wanted.end(), light) == wanted.end();
+        }
+        // Same lights in the same order
+        CHECK(built == wanted);
+    }
+}
+
+void testMatchesBruteForce() {
+    LightSet lights = makeLights(800);
+    const glm::mat4 views[2] = {
+        glm::lookAt(glm::vec3(3.0f, 12.0f, 50.0f), glm::vec3(0.0f, 8.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
+        glm::lookAt(glm::vec3(-20.0f, 4.0f, -10.0f), glm::vec3(30.0f, 10.0f, 25.0f), glm::vec3(0.0f, 1.0f, 0.0f))
+    };
+    for (const glm::mat4& view : views) {
+        size_t missing, extra;
+        compareWithBruteForce(LIGHT_CLUSTERS_SCALAR, lights, view, missing, extra);
+        CHECK_EQUAL(missing, 0);
+        CHECK_EQUAL(extra, 0);
+#ifdef LIGHT_CLUSTERS_SSE
+        compareWithBruteForce(LIGHT_CLUSTERS_SIMD, lights, view, missing, extra);
+        CHECK_EQUAL(missing, 0);
+        CHECK_EQUAL(extra, 0);
+#endif
+    }
+}
+
+void testKernelsAgree() {
+    LightSet lights = makeLights(2000);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 12.0f, 80.0f), glm::vec3(0.0f, 8.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    LightClusterKernel previous = lightClusterKernel;
+    LightClusters scalar;
+    LightClusters simd;
+    scalar.setProjection(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 500.0f);
+    simd.setProjection(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 500.0f);
+    lightClusterKernel = LIGHT_CLUSTERS_SCALAR;
+    scalar.build(view, lights.positions.data(), lights.radii.data(), (int)lights.positions.size());
+    lightClusterKernel = LIGHT_CLUSTERS_SIMD;
+    simd.build(view, lights.positions.data(), lights.radii.data(), (int)lights.positions.size());
+    lightClusterKernel = previous;
+    CHECK(scalar.grid() == simd.grid());
+    CHECK(scalar.indices() == simd.indices());
+    CHECK(scalar.stats.references > 0);
+    CHECK_EQUAL(scalar.stats.references, simd.indices().size());
+}
+
+// lighting.fs has no cluster counts of its own, they are put in after its #version line
+void testShaderDefines() {
+    std::string defines = clusterShaderDefines();
+    CHECK(defines.find("#define CLUSTER_COUNT_X 16\n") != std::string::npos);
+    CHECK(defines.find("#define CLUSTER_COUNT_Y 9\n") != std::string::npos);
+    CHECK(defines.find("#define CLUSTER_COUNT_Z 24\n") != std::string::npos);
+
+    std::string source = "#version 430 core\nvoid main() {}\n";
+    CHECK(insertDefines(source, defines) == "#version 430 core\n" + defines + "void main() {}\n");
+    CHECK(insertDefines("void main() {}\n", defines) == defines + "void main() {}\n");
+    CHECK(insertDefines(source, "") == source);
+}
+
+int main() {
+    testMatchesBruteForce();
+    testKernelsAgree();
+    testShaderDefines();
+    return finishTests("lightClusters_test");
+}
@@ -0,0 +1,164 @@
+#include "lightRegistry.h"
+#include "lightClusters.h"
+#include "test.h"
+
+// One buffer write from a flush, offset in bytes and what was packed
+struct FlushWrite
+{
+    size_t offset;
+    std::vector<uint8_t> bytes;
+};
+
+std::vector<FlushWrite> flushWrites(LightRegistry& registry) {
+    std::vector<FlushWrite> writes;
+    registry.flush([&](const std::vector<uint8_t>& bytes, size_t offset) {
+        writes.push_back({ offset, bytes });
+    });
+    return writes;
+}
+
+float floatAt(const std::vector<uint8_t>& bytes, size_t offset) {
+    float value;
+    memcpy(&value, &bytes[offset], 4);
+    return value;
+}
+
+// The torch the game places, bright enough to have a radius of a few blocks
+PointLightData makeLight(float x) {
+    PointLightData light;
+    light.position = glm::vec3(x, 0.0f, 0.0f);
+    light.constant = 1.0f;
+    light.linear = 0.18f;
+    light.quadratic = 0.12f;
+    light.ambient = glm::vec3(0.3f, 0.24f, 0.14f);
+    light.diffuse = glm::vec3(0.7f, 0.5f, 0.3f);
+    light.specular = glm::vec3(1.0f, 0.9f, 0.8f);
+    return light;
+}
+
+void testSlotReuse() {
+    LightRegistry registry(8);
+    for (int i = 0; i < 4; i++) {
+        CHECK_EQUAL(registry.add(makeLight((float)i)), i);
+    }
+    flushWrites(registry);
+
+    registry.remove(1);
+    CHECK_EQUAL(registry.count(), 3);
+    CHECK_EQUAL(registry.slotCount(), 4);
+    CHECK(!registry.isActive(1));
+    CHECK(registry.radiusData()[1] == 0.0f);
+    // Nothing reads a removed slot, so removing sends nothing
+    CHECK(!registry.isDirty());
+    CHECK(flushWrites(registry).empty());
+    // Removing twice does nothing
+    registry.remove(1);
+    CHECK_EQUAL(registry.count(), 3);
+
+    // The next light goes in the freed slot and only that slot is sent
+    CHECK_EQUAL(registry.add(makeLight(9.0f)), 1);
+    CHECK_EQUAL(registry.slotCount(), 4);
+    std::vector<FlushWrite> writes = flushWrites(registry);
+    CHECK_EQUAL(writes.size(), 1);
+    CHECK_EQUAL(writes[0].offset, POINT_LIGHT_STRIDE);
+    CHECK_EQUAL(writes[0].bytes.size(), POINT_LIGHT_STRIDE);
+    CHECK(floatAt(writes[0].bytes, 0) == 9.0f);
+    CHECK(registry.get(1).position.x == 9.0f);
+    CHECK_EQUAL(registry.nearest(glm::vec3(8.5f, 0.0f, 0.0f), 2.0f), 1);
+    CHECK_EQUAL(registry.nearest(glm::vec3(100.0f, 0.0f, 0.0f), 2.0f), -1);
+}
+
+// A removed slot has a radius of 0, so the clusters never point the shader at it
+void testRemovedSlotsNotClustered() {
+    LightRegistry registry(16);
+    for (int i = 0; i < 200; i++) {
+        registry.add(makeLight((float)(i % 20) - 10.0f));
+    }
+    int removed = 10;
+    registry.remove(removed);
+    LightClusters clusters;
+    clusters.setProjection(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 500.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 5.0f, 20.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    clusters.build(view, registry.positionData(), registry.radiusData(), registry.slotCount());
+    CHECK(!clusters.indices().empty());
+    for (uint32_t light : clusters.indices()) {
+        CHECK(light != (uint32_t)removed);
+    }
+}
+
+void testDirtyRangesMerge() {
+    LightRegistry registry(16);
+    for (int i = 0; i < 8; i++) {
+        registry.add(makeLight((float)i));
+    }
+    std::vector<FlushWrite> writes = flushWrites(registry);
+    CHECK_EQUAL(writes.size(), 1);
+    CHECK_EQUAL(writes[0].offset, 0);
+    CHECK_EQUAL(writes[0].bytes.size(), 8 * POINT_LIGHT_STRIDE);
+    CHECK_EQUAL(registry.stats.lightsUploadedLastFlush, 8);
+
+    // Nothing changed, nothing sent
+    for (int frame = 0; frame < 100; frame++) {
+        CHECK(flushWrites(registry).empty());
+    }
+    CHECK_EQUAL(registry.stats.lightsUploadedLastFlush, 0);
+    CHECK_EQUAL(registry.stats.lightsUploaded, 8);
+
+    // Changes out of order that touch each other become one write
+    registry.set(2, makeLight(2.0f));
+    registry.set(0, makeLight(0.0f));
+    registry.set(1, makeLight(1.0f));
+    writes = flushWrites(registry);
+    CHECK_EQUAL(writes.size(), 1);
+    CHECK_EQUAL(writes[0].offset, 0);
+    CHECK_EQUAL(writes[0].bytes.size(), 3 * POINT_LIGHT_STRIDE);
+
+    // Changes with a gap between them stay separate writes, and a slot changed twice is sent once
+    registry.set(6, makeLight(60.0f));
+    registry.set(2, makeLight(20.0f));
+    registry.set(6, makeLight(61.0f));
+    writes = flushWrites(registry);
+    CHECK_EQUAL(writes.size(), 2);
+    CHECK_EQUAL(writes[0].offset, 2 * POINT_LIGHT_STRIDE);
+    CHECK_EQUAL(writes[1].offset, 6 * POINT_LIGHT_STRIDE);
+    CHECK_EQUAL(writes[1].bytes.size(), POINT_LIGHT_STRIDE);
+    CHECK(floatAt(writes[1].bytes, 0) == 61.0f);
+    CHECK_EQUAL(registry.stats.lightsUploadedLastFlush, 2);
+    CHECK_EQUAL(registry.stats.writesLastFlush, 2);
+}
+
+void testGrowResendsEverything() {
+    LightRegistry registry(2);
+    registry.add(makeLight(0.0f));
+    registry.add(makeLight(1.0f));
+    flushWrites(registry);
+    CHECK_EQUAL(registry.storageSize(), 2 * POINT_LIGHT_STRIDE);
+    CHECK_EQUAL(registry.stats.grows, 0);
+
+    // A third light doesn't fit, the buffer is made again and has to get every light, not just the new one
+    CHECK_EQUAL(registry.add(makeLight(2.0f)), 2);
+    CHECK_EQUAL(registry.stats.grows, 1);
+    CHECK_EQUAL(registry.storageSize(), 4 * POINT_LIGHT_STRIDE);
+    std::vector<FlushWrite> writes = flushWrites(registry);
+    CHECK_EQUAL(writes.size(), 1);
+    CHECK_EQUAL(writes[0].offset, 0);
+    CHECK_EQUAL(writes[0].bytes.size(), 3 * POINT_LIGHT_STRIDE);
+    for (int slot = 0; slot < 3; slot++) {
+        CHECK(floatAt(writes[0].bytes, slot * POINT_LIGHT_STRIDE) == (float)slot);
+    }
+
+    // Room is left after growing, so the next light is just itself
+    CHECK_EQUAL(registry.add(makeLight(3.0f)), 3);
+    CHECK_EQUAL(registry.stats.grows, 1);
+    writes = flushWrites(registry);
+    CHECK_EQUAL(writes.size(), 1);
+    CHECK_EQUAL(writes[0].offset, 3 * POINT_LIGHT_STRIDE);
+}
+
+int main() {
+    testSlotReuse();
+    testRemovedSlotsNotClustered();
+    testDirtyRangesMerge();
+    testGrowResendsEverything();
+    return finishTests("lightRegistry_test");
+}
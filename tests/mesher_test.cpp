@@ -0,0 +1,180 @@
+#include <cstddef>
+#include <set>
+#include <tuple>
+#include "mesher.h"
+#include "test.h"
+
+// One block sized face: which way it points, the plane it is on, where it starts along the other two axes and its texture layer
+typedef std::tuple<int, int, int, int, int> Face;
+
+// Splits every quad of a mesh back into the block sized faces it covers
+std::set<Face> meshFaces(const std::vector<PackedVertex>& vertices) {
+    std::set<Face> faces;
+    for (size_t quad = 0; quad + 6 <= vertices.size(); quad += 6) {
+        int low[3] = { 1 << 30, 1 << 30, 1 << 30 };
+        int high[3] = { -1, -1, -1 };
+        int normal = 0;
+        int layer = 0;
+        for (size_t i = quad; i < quad + 6; i++) {
+            int pos[3], u, v;
+            unpackVertex(vertices[i], pos[0], pos[1], pos[2], normal, u, v, layer);
+            for (int axis = 0; axis < 3; axis++) {
+                low[axis] = pos[axis] < low[axis] ? pos[axis] : low[axis];
+                high[axis] = pos[axis] > high[axis] ? pos[axis] : high[axis];
+            }
+        }
+        int axis = normal / 2;
+        int axis0 = (axis + 1) % 3;
+        int axis1 = (axis + 2) % 3;
+        for (int a = low[axis0]; a < high[axis0]; a++) {
+            for (int b = low[axis1]; b < high[axis1]; b++) {
+                faces.insert(Face(normal, low[axis], a, b, layer));
+            }
+        }
+    }
+    return faces;
+}
+
+// Bottom faces at y = 0 are never drawn, so the tests build on y = 1 to see all six sides
+void testSingleBlock() {
+    VoxelWorld world;
+    world.setBlock(3, 1, 5, BLOCK_STONE);
+    std::vector<PackedVertex> vertices;
+    const Chunk& chunk = *world.getChunk({ 0, 0 });
+
+    MeshStats culled = meshChunkCulled(world, chunk, vertices);
+    CHECK_EQUAL(culled.blocks, 1);
+    CHECK_EQUAL(culled.quads, 6);
+    CHECK_EQUAL(vertices.size(), 6 * 6);
+
+    MeshStats greedy = meshChunkGreedy(world, chunk, vertices);
+    CHECK_EQUAL(greedy.quads, 6);
+}
+
+void testFlatSlab() {
+    VoxelWorld world;
+    for (int z = 0; z < CHUNK_SIZE; z++) {
+        for (int x = 0; x < CHUNK_SIZE; x++) {
+            world.setBlock(x, 1, z, BLOCK_DIRT);
+        }
+    }
+    std::vector<PackedVertex> vertices;
+    const Chunk& chunk = *world.getChunk({ 0, 0 });
+
+    // A top and bottom face for every block plus the 16 faces along each of the four sides
+    MeshStats culled = meshChunkCulled(world, chunk, vertices);
+    CHECK_EQUAL(culled.quads, CHUNK_SIZE * CHUNK_SIZE * 2 + 4 * CHUNK_SIZE);
+
+    MeshStats greedy = meshChunkGreedy(world, chunk, vertices);
+    CHECK_EQUAL(greedy.quads, 6);
+}
+
+void testChunkBoundary() {
+    VoxelWorld world;
+    world.setBlock(CHUNK_SIZE - 1, 1, 0, BLOCK_STONE);
+    world.setBlock(CHUNK_SIZE, 1, 0, BLOCK_STONE);
+    std::vector<PackedVertex> vertices;
+
+    for (int chunkX = 0; chunkX < 2; chunkX++) {
+        const Chunk& chunk = *world.getChunk({ chunkX, 0 });
+        MeshStats culled = meshChunkCulled(world, chunk, vertices);
+        CHECK_EQUAL(culled.quads, 5);
+        std::set<Face> faces = meshFaces(vertices);
+        // The face the two blocks share is on the plane between the chunks, x = 16 in the first and x = 0 in the second
+        int sharedPlane = chunkX == 0 ? CHUNK_SIZE : 0;
+        for (const Face& face : faces) {
+            CHECK(!(std::get<0>(face) / 2 == 0 && std::get<1>(face) == sharedPlane));
+        }
+
+        MeshStats greedy = meshChunkGreedy(world, chunk, vertices);
+        CHECK_EQUAL(greedy.quads, 5);
+    }
+}
+
+// Random blocks of mixed types over a 3 x 3 chunk area, the middle chunk has neighbours on every side
+void testSameFaces() {
+    VoxelWorld world;
+    uint32_t state = 12345;
+    for (int i = 0; i < 20000; i++) {
+        state = state * 1664525u + 1013904223u;
+        int x = (int)(state >> 8) % (CHUNK_SIZE * 3) - CHUNK_SIZE;
+        state = state * 1664525u + 1013904223u;
+        int z = (int)(state >> 8) % (CHUNK_SIZE * 3) - CHUNK_SIZE;
+        state = state * 1664525u + 1013904223u;
+        int y = (int)(state >> 8) % 12;
+        world.setBlock(x, y, z, (BlockID)(BLOCK_DIRT + (state >> 28) % 3));
+    }
+
+    std::vector<PackedVertex> culledVertices;
+    std::vector<PackedVertex> greedyVertices;
+    world.forEachChunk([&](const Chunk& chunk) {
+        MeshStats culled = meshChunkCulled(world, chunk, culledVertices);
+        MeshStats greedy = meshChunkGreedy(world, chunk, greedyVertices);
+        CHECK(greedy.quads <= culled.quads);
+        std::set<Face> culledFaces = meshFaces(culledVertices);
+        CHECK_EQUAL(culledFaces.size(), culled.quads);
+        CHECK(meshFaces(greedyVertices) == culledFaces);
+    });
+}
+
+// A solid 3 x 3 x 3 block only hides its middle, including when the middle sits on either side of a chunk edge
+void testExposedBlocks() {
+    for (int middleX : { 5, CHUNK_SIZE - 1, CHUNK_SIZE }) {
+        VoxelWorld world;
+        for (int y = 1; y <= 3; y++) {
+            for (int z = 4; z <= 6; z++) {
+                for (int x = middleX - 1; x <= middleX + 1; x++) {
+                    world.setBlock(x, y, z, BLOCK_STONE);
+                }
+            }
+        }
+        std::set<std::tuple<int, int, int>> exposed;
+        size_t total = world.forEachExposedBlock([&](int x, int y, int z, BlockID) {
+            exposed.insert(std::make_tuple(x, y, z));
+        });
+        CHECK_EQUAL(exposed.size(), 26);
+        CHECK(exposed.count(std::make_tuple(middleX, 2, 5)) == 0);
+        CHECK_EQUAL(total, 27);
+        CHECK_EQUAL(total, world.blockCount());
+    }
+}
+
+// lighting.vs reads an instance as a vec3 at offset 0 and a uint at offset 12 with a stride of sizeof(BlockInstance)
+static_assert(sizeof(BlockInstance) == 16, "BlockInstance has to match the instance attributes in lighting.vs");
+static_assert(offsetof(BlockInstance, layer) == 12, "BlockInstance has to match the instance attributes in lighting.vs");
+
+// Every exposed block gets one instance at its world position drawn with its own texture layer
+void testBlockInstances() {
+    VoxelWorld world;
+    world.setBlock(-3, 1, 7, BLOCK_STONE);
+    world.setBlock(CHUNK_SIZE + 2, 5, -1, BLOCK_DIRT);
+    world.setBlock(0, CHUNK_HEIGHT - 1, 0, (BlockID)(BLOCK_DIRT + 1));
+
+    BlockInstance single = packBlockInstance(-3, 1, 7, BLOCK_STONE);
+    CHECK(single.x == -3.0f && single.y == 1.0f && single.z == 7.0f);
+    CHECK_EQUAL(single.layer, blockTextureLayer(BLOCK_STONE));
+
+    std::vector<BlockInstance> instances;
+    CHECK_EQUAL(buildBlockInstances(world, instances), 3);
+    CHECK_EQUAL(instances.size(), 3);
+    size_t matched = 0;
+    world.forEachBlock([&](int x, int y, int z, BlockID block) {
+        for (const BlockInstance& instance : instances) {
+            if (instance.x == (float)x && instance.y == (float)y && instance.z == (float)z) {
+                CHECK_EQUAL(instance.layer, blockTextureLayer(block));
+                matched++;
+            }
+        }
+    });
+    CHECK_EQUAL(matched, 3);
+}
+
+int main() {
+    testSingleBlock();
+    testFlatSlab();
+    testChunkBoundary();
+    testSameFaces();
+    testExposedBlocks();
+    testBlockInstances();
+    return finishTests("mesher_test");
+}
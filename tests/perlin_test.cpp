@@ -0,0 +1,114 @@
+#include "perlin.h"
+#include "test.h"
+
+// Sizes of lattice cell the tests run at, whole, fractional and small enough that a row crosses many cells
+const float cellSizes[] = { 64.0f, 17.5f, 3.0f };
+const GradientMode modes[] = { GRADIENT_ANGLE, GRADIENT_TABLE };
+
+// Every kernel this CPU can run, from the scalar one up to whatever detectPerlinKernel picked
+std::vector<PerlinKernel> supportedKernels() {
+    std::vector<PerlinKernel> kernels = { PERLIN_KERNEL_SCALAR };
+    PerlinKernel best = detectPerlinKernel();
+    if (best >= PERLIN_KERNEL_SSE41) {
+        kernels.push_back(PERLIN_KERNEL_SSE41);
+    }
+    if (best >= PERLIN_KERNEL_AVX2) {
+        kernels.push_back(PERLIN_KERNEL_AVX2);
+    }
+    return kernels;
+}
+
+// What every batch evaluator has to match bit for bit, one perlinNoise call per pixel
+void referenceTile(float* out, int startX, int startY, int tileWidth, int tileHeight, float cellSize, int seed, GradientMode mode) {
+    for (int row = 0; row < tileHeight; row++) {
+        for (int x = 0; x < tileWidth; x++) {
+            out[row * tileWidth + x] = perlinNoise((float)(startX + x) / cellSize, (float)(startY + row) / cellSize, seed, mode);
+        }
+    }
+}
+
+// Counts run from 1 so each kernel's vector loop and its scalar tail both get checked
+void testRowKernels() {
+    PerlinKernel previous = perlinKernel;
+    std::vector<float> row(200);
+    std::vector<float> expected(200);
+    for (PerlinKernel kernel : supportedKernels()) {
+        perlinKernel = kernel;
+        for (GradientMode mode : modes) {
+            for (float cellSize : cellSizes) {
+                for (int count = 1; count <= 67; count += 11) {
+                    for (int startX : { 0, 13, 1000, 262144 }) {
+                        float y = (startX + count * 7) / cellSize;
+                        perlinNoiseRow(row.data(), startX, count, cellSize, y, 1234, mode);
+                        for (int i = 0; i < count; i++) {
+                            expected[i] = perlinNoise((float)(startX + i) / cellSize, y, 1234, mode);
+                        }
+                        CHECK(memcmp(row.data(), expected.data(), sizeof(float) * count) == 0);
+                    }
+                }
+            }
+        }
+    }
+    perlinKernel = previous;
+}
+
+void testTiles() {
+    PerlinKernel previous = perlinKernel;
+    const int width = 45;
+    const int height = 37;
+    std::vector<float> tile(width * height);
+    std::vector<float> expected(width * height);
+    for (PerlinKernel kernel : supportedKernels()) {
+        perlinKernel = kernel;
+        for (GradientMode mode : modes) {
+            for (float cellSize : cellSizes) {
+                for (int start : { 0, 100, 262144 }) {
+                    perlinNoiseTile(tile.data(), width, start, start + 5, width, height, cellSize, 99, mode);
+                    referenceTile(expected.data(), start, start + 5, width, height, cellSize, 99, mode);
+                    CHECK(memcmp(tile.data(), expected.data(), sizeof(float) * tile.size()) == 0);
+                }
+            }
+        }
+    }
+    perlinKernel = previous;
+}
+
+// A single FBM octave has an amplitude of 1 and nothing to add, so it has to be exactly perlinNoiseTile
+void testSingleOctaveFractal() {
+    const int width = 45;
+    const int height = 37;
+    FractalSettings fractal = createFractalSettings(FRACTAL_FBM, 1);
+    std::vector<float> tile(width * height);
+    std::vector<float> expected(width * height);
+    for (GradientMode mode : modes) {
+        for (float cellSize : cellSizes) {
+            fractalNoiseTile(tile.data(), width, 300, 200, width, height, cellSize, 7, mode, fractal);
+            referenceTile(expected.data(), 300, 200, width, height, cellSize, 7, mode);
+            CHECK(memcmp(tile.data(), expected.data(), sizeof(float) * tile.size()) == 0);
+        }
+    }
+}
+
+// Settings filled in by hand can ask for more octaves than there is room for and cells that never shrink
+void testOversizedFractal() {
+    const int width = 20;
+    const int height = 20;
+    FractalSettings fractal = createFractalSettings(FRACTAL_FBM, MAX_OCTAVES);
+    fractal.octaves = MAX_OCTAVES * 4;
+    fractal.lacunarity = 1.0f;
+    std::vector<float> tile(width * height);
+    fractalNoiseTile(tile.data(), width, 50, 50, width, height, 16.0f, 3, GRADIENT_ANGLE, fractal);
+    for (float value : tile) {
+        CHECK(value >= -1.0f && value <= 1.0f);
+    }
+    CHECK(createFractalSettings(FRACTAL_FBM, 4, 0.0f).lacunarity > 0.0f);
+    CHECK(createFractalSettings(FRACTAL_FBM, 4, -2.0f).lacunarity > 0.0f);
+}
+
+int main() {
+    testRowKernels();
+    testTiles();
+    testSingleOctaveFractal();
+    testOversizedFractal();
+    return finishTests("perlin_test");
+}
@@ -0,0 +1,146 @@
+#include "frameUniforms.h"
+#include "test.h"
+
+float floatAt(const std::vector<uint8_t>& bytes, size_t offset) {
+    float value;
+    memcpy(&value, &bytes[offset], 4);
+    return value;
+}
+
+uint32_t uintAt(const std::vector<uint8_t>& bytes, size_t offset) {
+    uint32_t value;
+    memcpy(&value, &bytes[offset], 4);
+    return value;
+}
+
+void testScalarsAndVectors() {
+    std::vector<uint8_t> bytes;
+    Std140Writer writer(bytes);
+    CHECK_EQUAL(writer.write(1.0f), 0);
+    CHECK_EQUAL(writer.write(glm::vec3(1.0f)), 16);
+    CHECK_EQUAL(writer.write(glm::vec2(1.0f)), 32);
+    CHECK_EQUAL(writer.write(glm::vec4(1.0f)), 48);
+    CHECK_EQUAL(writer.write(true), 64);
+    CHECK_EQUAL(uintAt(bytes, 64), 1);
+    CHECK_EQUAL(writer.write(7), 68);
+}
+
+// A float declared after a vec3 goes in the gap at the end of it, so the two take 16 bytes together
+void testVec3ThenFloat() {
+    std::vector<uint8_t> bytes;
+    Std140Writer writer(bytes);
+    CHECK_EQUAL(writer.write(glm::vec3(1.0f, 2.0f, 3.0f)), 0);
+    CHECK_EQUAL(writer.write(4.0f), 12);
+    CHECK_EQUAL(writer.size(), 16);
+    CHECK(floatAt(bytes, 8) == 3.0f);
+    CHECK(floatAt(bytes, 12) == 4.0f);
+    // Anything after starts on the next vec4
+    CHECK_EQUAL(writer.write(glm::vec3(0.0f)), 16);
+}
+
+// Each column of a mat3 is padded out to a vec4
+void testMat3() {
+    std::vector<uint8_t> bytes;
+    Std140Writer writer(bytes);
+    writer.write(1.0f);
+    glm::mat3 matrix(1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f, 9.0f);
+    CHECK_EQUAL(writer.write(matrix), 16);
+    CHECK_EQUAL(writer.size(), 16 + 3 * 16);
+    for (int column = 0; column < 3; column++) {
+        for (int row = 0; row < 3; row++) {
+            CHECK(floatAt(bytes, 16 + column * 16 + row * 4) == matrix[column][row]);
+        }
+        CHECK(floatAt(bytes, 16 + column * 16 + 12) == 0.0f);
+    }
+}
+
+void testArrays() {
+    std::vector<uint8_t> bytes;
+    Std140Writer writer(bytes);
+    writer.write(1.0f);
+    float values[3] = { 1.0f, 2.0f, 3.0f };
+    CHECK_EQUAL(writer.writeArray(values, 3), 16);
+    CHECK_EQUAL(writer.size(), 16 + 3 * 16);
+    CHECK(floatAt(bytes, 32) == 2.0f);
+    CHECK(floatAt(bytes, 48) == 3.0f);
+}
+
+// The offsets are the ones the FrameData block in lighting.fs has, as glGetActiveUniformsiv(GL_UNIFORM_OFFSET) reports them
+void testFrameData() {
+    FrameData frame = {};
+    frame.projection = glm::mat4(2.0f);
+    frame.view = glm::mat4(3.0f);
+    frame.viewPos = glm::vec3(1.0f, 2.0f, 3.0f);
+    frame.shininess = 5.0f;
+    frame.sun.direction = glm::vec3(4.0f);
+    frame.sun.ambient = glm::vec3(7.0f);
+    frame.sun.diffuse = glm::vec3(10.0f);
+    frame.sun.specular = glm::vec3(13.0f);
+    frame.pointLightCount = 9;
+    frame.blinn = true;
+    frame.gamma = true;
+    frame.clusterZScale = 17.0f;
+    frame.clusterTileScale = glm::vec2(18.0f, 19.0f);
+    frame.clusterZBias = 20.0f;
+
+    std::vector<uint8_t> bytes;
+    CHECK_EQUAL(packFrameData(frame, bytes), FRAME_DATA_SIZE);
+    CHECK_EQUAL(bytes.size(), 224);
+    CHECK(floatAt(bytes, 0) == 2.0f);
+    CHECK(floatAt(bytes, 64) == 3.0f);
+    CHECK(floatAt(bytes, 128) == 1.0f && floatAt(bytes, 136) == 3.0f);
+    CHECK(floatAt(bytes, 140) == 5.0f);
+    CHECK(floatAt(bytes, 144) == 4.0f);
+    CHECK_EQUAL(uintAt(bytes, 156), 9);
+    CHECK(floatAt(bytes, 160) == 7.0f);
+    CHECK_EQUAL(uintAt(bytes, 172), 1);
+    CHECK(floatAt(bytes, 176) == 10.0f);
+    CHECK_EQUAL(uintAt(bytes, 188), 1);
+    CHECK(floatAt(bytes, 192) == 13.0f);
+    CHECK(floatAt(bytes, 204) == 17.0f);
+    CHECK(floatAt(bytes, 208) == 18.0f && floatAt(bytes, 212) == 19.0f);
+    CHECK(floatAt(bytes, 216) == 20.0f);
+}
+
+void testPointLightStride() {
+    PointLightData lights[2];
+    for (int i = 0; i < 2; i++) {
+        float base = i * 20.0f;
+        lights[i].position = glm::vec3(base + 1.0f, base + 2.0f, base + 3.0f);
+        lights[i].constant = base + 4.0f;
+        lights[i].linear = base + 5.0f;
+        lights[i].quadratic = base + 6.0f;
+        lights[i].ambient = glm::vec3(base + 7.0f);
+        lights[i].diffuse = glm::vec3(base + 10.0f);
+        lights[i].specular = glm::vec3(base + 13.0f);
+    }
+
+    std::vector<uint8_t> bytes;
+    Std140Writer writer(bytes);
+    for (int i = 0; i < 2; i++) {
+        writePointLight(writer, lights[i]);
+        CHECK_EQUAL(writer.size(), (i + 1) * POINT_LIGHT_STRIDE);
+    }
+    CHECK_EQUAL(POINT_LIGHT_STRIDE, 80);
+    for (int i = 0; i < 2; i++) {
+        size_t offset = i * POINT_LIGHT_STRIDE;
+        float base = i * 20.0f;
+        CHECK(floatAt(bytes, offset) == base + 1.0f);
+        CHECK(floatAt(bytes, offset + 12) == base + 4.0f);
+        CHECK(floatAt(bytes, offset + 16) == base + 5.0f);
+        CHECK(floatAt(bytes, offset + 20) == base + 6.0f);
+        CHECK(floatAt(bytes, offset + 32) == base + 7.0f);
+        CHECK(floatAt(bytes, offset + 48) == base + 10.0f);
+        CHECK(floatAt(bytes, offset + 64) == base + 13.0f);
+    }
+}
+
+int main() {
+    testScalarsAndVectors();
+    testVec3ThenFloat();
+    testMat3();
+    testArrays();
+    testFrameData();
+    testPointLightStride();
+    return finishTests("std140_test");
+}
@@ -0,0 +1,37 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+// Counts failed checks, a test's main returns this so ctest sees any failure
+int testFailures = 0;
+
+// Prints the check and where it is when it fails and carries on, so one run shows every failure
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            testFailures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQUAL(actual, expected) \
+    do { \
+        long long actualValue = (long long)(actual); \
+        long long expectedValue = (long long)(expected); \
+        if (actualValue != expectedValue) { \
+            printf("%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, actualValue, expectedValue); \
+            testFailures++; \
+        } \
+    } while (0)
+
+int finishTests(const char* name) {
+    if (testFailures > 0) {
+        printf("%s: %d checks failed\n", name, testFailures);
+        return 1;
+    }
+    printf("%s: passed\n", name);
+    return 0;
+}
+
+#endif
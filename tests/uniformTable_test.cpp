@@ -0,0 +1,122 @@
+#include <shader.h>
+#include "test.h"
+
+/*
+A linked program made up in memory. Uniforms are listed the way glGetActiveUniform lists them, an array of plain values
+once under its first element, and each element gets its own location like a real program gives them. Uniforms in a
+block are listed but have no location.
+*/
+class FakeUniformReflection : public UniformReflection
+{
+public:
+    void addUniform(const std::string& name) {
+        active.push_back({ name, 1 });
+        locations[name] = nextLocation++;
+    }
+
+    void addArray(const std::string& name, int size) {
+        active.push_back({ name + "[0]", size });
+        for (int i = 0; i < size; i++) {
+            locations[name + "[" + std::to_string(i) + "]"] = nextLocation++;
+        }
+    }
+
+    void addBlockMember(const std::string& name) {
+        active.push_back({ name, 1 });
+    }
+
+    int activeUniformCount() const override {
+        return (int)active.size();
+    }
+
+    void activeUniform(int index, std::string& name, int& size) const override {
+        name = active[index].name;
+        size = active[index].size;
+    }
+
+    int uniformLocation(const char* name) const override {
+        auto found = locations.find(name);
+        return found == locations.end() ? -1 : found->second;
+    }
+
+    int locationOf(const std::string& name) const {
+        return uniformLocation(name.c_str());
+    }
+
+private:
+    struct ActiveUniform {
+        std::string name;
+        int size;
+    };
+    std::vector<ActiveUniform> active;
+    std::unordered_map<std::string, int> locations;
+    int nextLocation = 0;
+};
+
+FakeUniformReflection makeProgram() {
+    FakeUniformReflection program;
+    program.addUniform("model");
+    program.addArray("weights", 4);
+    // An array of structs is listed member by member, every element separately
+    for (int i = 0; i < 4; i++) {
+        program.addUniform("pointLights[" + std::to_string(i) + "].position");
+    }
+    program.addArray("lights", 8);
+    program.addBlockMember("FrameData.view");
+    program.addBlockMember("projection");
+    return program;
+}
+
+void testArrays() {
+    FakeUniformReflection program = makeProgram();
+    UniformTable table;
+    table.build(program);
+
+    for (int i = 0; i < 8; i++) {
+        std::string element = "lights[" + std::to_string(i) + "]";
+        CHECK(table.location(element) >= 0);
+        CHECK_EQUAL(table.location(element), program.locationOf(element));
+    }
+    CHECK_EQUAL(table.location("lights[8]"), -1);
+    CHECK_EQUAL(table.location("pointLights[3].position"), program.locationOf("pointLights[3].position"));
+    CHECK_EQUAL(table.location("pointLights[4].position"), -1);
+    CHECK_EQUAL(table.location("weights[3]"), program.locationOf("weights[3]"));
+    CHECK_EQUAL(table.location("weights[4]"), -1);
+
+    // The bare name of an array is its first element, like glGetUniformLocation
+    CHECK_EQUAL(table.location("weights"), program.locationOf("weights[0]"));
+    CHECK_EQUAL(table.location("lights"), program.locationOf("lights[0]"));
+    CHECK_EQUAL(table.location("model"), program.locationOf("model"));
+}
+
+void testBlockMembersSkipped() {
+    FakeUniformReflection program = makeProgram();
+    UniformTable table;
+    table.build(program);
+    CHECK_EQUAL(table.location("FrameData.view"), -1);
+    CHECK_EQUAL(table.location("projection"), -1);
+    // model, weights and its 4 elements, 4 point light positions, lights and its 8 elements
+    CHECK_EQUAL(table.size(), 1 + 5 + 4 + 9);
+}
+
+void testHandles() {
+    Shader shader;
+    shader.ID = 0;
+    CHECK(!shader.uniform<float>("model").valid());
+
+    shader.cacheUniforms(makeProgram());
+    Uniform<glm::mat4> model = shader.uniform<glm::mat4>("model");
+    CHECK(model.valid());
+    CHECK_EQUAL(model.location, shader.uniformLocation("model"));
+    CHECK(shader.uniform<glm::vec3>("lights[7]").valid());
+    CHECK(!shader.uniform<float>("missing").valid());
+    CHECK(!shader.uniform<glm::mat4>("projection").valid());
+    CHECK_EQUAL(shader.uniformLocation("missing"), -1);
+}
+
+int main() {
+    testArrays();
+    testBlockMembersSkipped();
+    testHandles();
+    return finishTests("uniformTable_test");
+}
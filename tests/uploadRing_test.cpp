@@ -0,0 +1,160 @@
+#include <set>
+#include "uploadRing.h"
+#include "test.h"
+
+/*
+Stands in for the GPU. Fences are numbered and stay unsignalled until passFence is called, a wait with a timeout passes
+the fence like the GPU catching up would. Every call is counted so the tests can see what the ring asked for.
+*/
+class MockUploadBackend : public UploadBackend
+{
+public:
+    std::vector<uint8_t> memory;
+    std::set<size_t> liveFences;
+    std::set<size_t> passedFences;
+    std::vector<size_t> waitedFences;  // Every fence waitFence was called with, in order
+    size_t allocations = 0;
+    size_t flushedBytes = 0;
+    size_t nextFence = 1;
+
+    uint8_t* allocate(size_t size) override {
+        memory.assign(size, 0);
+        allocations++;
+        return memory.data();
+    }
+
+    void flush(size_t offset, size_t size) override {
+        CHECK(offset + size <= memory.size());
+        flushedBytes += size;
+    }
+
+    UploadFence insertFence() override {
+        liveFences.insert(nextFence);
+        return (UploadFence)nextFence++;
+    }
+
+    bool waitFence(UploadFence fence, uint64_t timeout) override {
+        size_t id = (size_t)fence;
+        CHECK(liveFences.count(id) == 1);
+        waitedFences.push_back(id);
+        if (timeout > 0) {
+            passFence(fence);
+        }
+        return passedFences.count(id) == 1;
+    }
+
+    void deleteFence(UploadFence fence) override {
+        CHECK(liveFences.erase((size_t)fence) == 1);
+    }
+
+    unsigned int buffer() const override {
+        return (unsigned int)allocations;
+    }
+
+    void passFence(UploadFence fence) {
+        passedFences.insert((size_t)fence);
+    }
+};
+
+void testOffsetsRotate() {
+    MockUploadBackend backend;
+    UploadRing ring(backend, 256, 3);
+    uint8_t data[100] = { 7 };
+    // The first write goes into the section after the one counted as current, and every write after moves on by one
+    const size_t expected[] = { 256, 512, 0, 256, 512, 0 };
+    for (size_t offset : expected) {
+        CHECK_EQUAL(ring.write(data, sizeof(data)), offset);
+        CHECK_EQUAL(backend.memory[offset], 7);
+    }
+    CHECK_EQUAL(ring.stats.writes, 6);
+    CHECK_EQUAL(ring.stats.bytesWritten, 600);
+    CHECK_EQUAL(backend.flushedBytes, 600);
+    CHECK_EQUAL(backend.allocations, 1);
+}
+
+void testWaitsBeforeReuse() {
+    MockUploadBackend backend;
+    UploadRing ring(backend, 64, 3);
+    uint8_t data[16] = { 0 };
+    UploadFence fences[3];
+    for (int i = 0; i < 3; i++) {
+        ring.write(data, sizeof(data));
+        ring.fenceReads();
+        fences[i] = (UploadFence)(backend.nextFence - 1);
+    }
+    CHECK(backend.waitedFences.empty());
+
+    // The GPU has finished with the first section, so reusing it checks the fence once and doesn't count as a wait
+    backend.passFence(fences[0]);
+    CHECK_EQUAL(ring.write(data, sizeof(data)), 64);
+    CHECK_EQUAL(backend.waitedFences.size(), 1);
+    CHECK_EQUAL(backend.waitedFences[0], (size_t)fences[0]);
+    CHECK_EQUAL(ring.stats.fenceWaits, 0);
+
+    // The second section is still being read, so the ring has to wait on its fence before writing over it
+    CHECK_EQUAL(ring.write(data, sizeof(data)), 128);
+    CHECK_EQUAL(backend.waitedFences.back(), (size_t)fences[1]);
+    CHECK(backend.passedFences.count((size_t)fences[1]) == 1);
+    CHECK_EQUAL(ring.stats.fenceWaits, 1);
+    CHECK(backend.liveFences.count((size_t)fences[0]) == 0);
+    CHECK(backend.liveFences.count((size_t)fences[1]) == 0);
+}
+
+void testGrowsForBigWrites() {
+    MockUploadBackend backend;
+    UploadRing ring(backend, 64, 3);
+    uint8_t small[32] = { 0 };
+    ring.write(small, sizeof(small));
+    ring.fenceReads();
+    int generation = ring.bufferGeneration();
+
+    std::vector<uint8_t> big(200, 9);
+    size_t offset = ring.write(big.data(), big.size());
+    CHECK_EQUAL(ring.stats.grows, 1);
+    CHECK_EQUAL(backend.allocations, 2);
+    CHECK(ring.bufferGeneration() != generation);
+    // 64 doubles to 256, the smallest section the write fits in
+    CHECK_EQUAL(ring.capacity(), 256 * 3);
+    CHECK(offset != (size_t)-1 && offset + big.size() <= backend.memory.size());
+    CHECK_EQUAL(backend.memory[offset + 199], 9);
+    // Everything fenced in the old buffer is waited for before it is replaced
+    CHECK_EQUAL(backend.waitedFences.size(), 1);
+    CHECK(backend.liveFences.empty());
+
+    // Writes that fit carry on without growing again
+    ring.write(small, sizeof(small));
+    CHECK_EQUAL(ring.stats.grows, 1);
+}
+
+void testNoFenceLeaks() {
+    MockUploadBackend backend;
+    {
+        UploadRing ring(backend, 128, 3);
+        uint8_t data[64] = { 0 };
+        for (int frame = 0; frame < 50; frame++) {
+            ring.write(data, sizeof(data));
+            ring.fenceReads();
+            // Fencing the same data twice replaces the first fence
+            if (frame % 7 == 0) {
+                ring.fenceReads();
+            }
+            if (frame % 3 == 0) {
+                backend.passFence((UploadFence)(backend.nextFence - 1));
+            }
+            if (frame == 20) {
+                std::vector<uint8_t> big(1000);
+                ring.write(big.data(), big.size());
+            }
+        }
+        CHECK(backend.liveFences.size() <= 3);
+    }
+    CHECK(backend.liveFences.empty());
+}
+
+int main() {
+    testOffsetsRotate();
+    testWaitsBeforeReuse();
+    testGrowsForBigWrites();
+    testNoFenceLeaks();
+    return finishTests("uploadRing_test");
+}
@@ -0,0 +1,142 @@
+#include <math.h>
+#include "world.h"
+#include "test.h"
+
+bool near(float a, float b) {
+    return fabsf(a - b) < 1e-4f;
+}
+
+bool cast(const VoxelWorld& world, float ox, float oy, float oz, float dx, float dy, float dz, float maxDistance, RaycastHit& hit) {
+    const float origin[3] = { ox, oy, oz };
+    const float direction[3] = { dx, dy, dz };
+    return raycastWorld(world, origin, direction, maxDistance, hit);
+}
+
+void checkHit(const RaycastHit& hit, int x, int y, int z, int nx, int ny, int nz) {
+    CHECK(hit.block[0] == x && hit.block[1] == y && hit.block[2] == z);
+    CHECK(hit.normal[0] == nx && hit.normal[1] == ny && hit.normal[2] == nz);
+}
+
+// Blocks are centred on whole numbers, so a ray from the middle of a block reaches the next face after half a block
+void testAxisAligned() {
+    VoxelWorld world;
+    world.setBlock(5, 1, 0, BLOCK_STONE);
+    world.setBlock(0, 1, 0, BLOCK_DIRT);
+    RaycastHit hit;
+
+    CHECK(cast(world, 1, 1, 0, 1, 0, 0, 10, hit));
+    checkHit(hit, 5, 1, 0, -1, 0, 0);
+    CHECK(near(hit.distance, 3.5f));
+    CHECK(hit.type == BLOCK_STONE);
+
+    // Down onto the top face, the direction doesn't have to be normalised
+    CHECK(cast(world, 0, 5, 0, 0, -3, 0, 10, hit));
+    checkHit(hit, 0, 1, 0, 0, 1, 0);
+    CHECK(near(hit.distance, 3.5f));
+    CHECK(hit.type == BLOCK_DIRT);
+
+    CHECK(!cast(world, 1, 1, 0, 0, 0, 1, 10, hit));
+    CHECK(!cast(world, 1, 1, 0, 0, 0, 0, 10, hit));
+}
+
+/*
+The first solid cell found by sampling points a small step apart along the ray, and the cell sampled before it.
+The step is small enough that no cell the tests' rays pass through can be skipped.
+*/
+bool sampleRay(const VoxelWorld& world, const float origin[3], const float direction[3], float maxDistance, int cell[3], int previous[3]) {
+    float length = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+    for (int i = 0; i < 3; i++) {
+        previous[i] = (int)floorf(origin[i] + 0.5f);
+    }
+    for (float t = 0.0f; t <= maxDistance; t += 0.0005f) {
+        for (int i = 0; i < 3; i++) {
+            cell[i] = (int)floorf(origin[i] + direction[i] / length * t + 0.5f);
+        }
+        if (world.isSolid(cell[0], cell[1], cell[2])) {
+            return true;
+        }
+        memcpy(previous, cell, sizeof(int) * 3);
+    }
+    return false;
+}
+
+// Diagonal rays through a scattered set of blocks land on the same block as sampling, and come in through the face it shares with the cell before
+void testDiagonal() {
+    VoxelWorld world;
+    uint32_t state = 777;
+    for (int i = 0; i < 400; i++) {
+        state = state * 1664525u + 1013904223u;
+        int x = (int)(state >> 8) % 24 - 12;
+        state = state * 1664525u + 1013904223u;
+        int y = (int)(state >> 8) % 10;
+        state = state * 1664525u + 1013904223u;
+        int z = (int)(state >> 8) % 24 - 12;
+        world.setBlock(x, y, z, BLOCK_STONE);
+    }
+    const float origin[3] = { 0.23f, 12.31f, -0.17f };
+    const float directions[][3] = {
+        { 1.0f, -0.7f, 0.4f }, { -0.6f, -1.0f, 0.3f }, { 0.35f, -0.45f, -1.0f }, { -1.0f, -0.55f, -0.8f }, { 0.2f, -1.0f, 0.05f }
+    };
+    for (const float* direction : directions) {
+        RaycastHit hit;
+        int cell[3], previous[3];
+        bool sampled = sampleRay(world, origin, direction, 30, cell, previous);
+        CHECK(cast(world, origin[0], origin[1], origin[2], direction[0], direction[1], direction[2], 30, hit) == sampled);
+        if (!sampled) {
+            continue;
+        }
+        checkHit(hit, cell[0], cell[1], cell[2], previous[0] - cell[0], previous[1] - cell[1], previous[2] - cell[2]);
+        // The distance is where the ray crosses into the block, on the plane of the face it came in through
+        int axis = hit.normal[0] != 0 ? 0 : (hit.normal[1] != 0 ? 1 : 2);
+        float length = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+        float face = hit.block[axis] + hit.normal[axis] * 0.5f;
+        CHECK(near(origin[axis] + direction[axis] / length * hit.distance, face));
+    }
+}
+
+// Cells on the negative side have to round down, not towards zero, including where the ray crosses from chunk -1 into -2
+void testNegativeChunkEdge() {
+    VoxelWorld world;
+    world.setBlock(-CHUNK_SIZE - 1, 1, -1, BLOCK_STONE);
+    world.setBlock(-5, 3, -1, BLOCK_DIRT);
+    RaycastHit hit;
+
+    CHECK(cast(world, -10, 1, -1, -1, 0, 0, 20, hit));
+    checkHit(hit, -CHUNK_SIZE - 1, 1, -1, 1, 0, 0);
+    CHECK(near(hit.distance, CHUNK_SIZE - 10 + 0.5f));
+
+    // From inside chunk -2 back across the edge towards positive x
+    world.setBlock(-CHUNK_SIZE, 1, -3, BLOCK_STONE);
+    CHECK(cast(world, -CHUNK_SIZE - 3, 1, -3, 1, 0, 0, 20, hit));
+    checkHit(hit, -CHUNK_SIZE, 1, -3, -1, 0, 0);
+    CHECK(near(hit.distance, 2.5f));
+}
+
+// A ray that starts inside a block hits it straight away with no face to point out of
+void testStartInside() {
+    VoxelWorld world;
+    world.setBlock(2, 2, 2, BLOCK_STONE);
+    RaycastHit hit;
+    CHECK(cast(world, 2.3f, 1.8f, 2.1f, 0, 1, 0, 5, hit));
+    checkHit(hit, 2, 2, 2, 0, 0, 0);
+    CHECK(hit.distance == 0.0f);
+}
+
+void testMaxDistance() {
+    VoxelWorld world;
+    world.setBlock(5, 1, 0, BLOCK_STONE);
+    RaycastHit hit;
+    CHECK(!cast(world, 0, 1, 0, 1, 0, 0, 4.4f, hit));
+    CHECK(cast(world, 0, 1, 0, 1, 0, 0, 4.6f, hit));
+    CHECK(near(hit.distance, 4.5f));
+    CHECK(!cast(world, 0, 1, 0, -1, 0, 0, 100, hit));
+}
+
+int main() {
+    testAxisAligned();
+    testDiagonal();
+    testNegativeChunkEdge();
+    testStartInside();
+    testMaxDistance();
+    return finishTests("world_test");
+}